@@ -0,0 +1,255 @@
+#include "ArchiveWriter.h"
+#include "PackageManager.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+
+// Бенчмарк конвейера установки.
+// Генерирует синтетические архивы (много мелких файлов, несколько огромных, смешанный)
+// в двух вариантах - обычный gzip и блочный BGZF, который разжимается параллельно, -
+// устанавливает их через PackageManager без GUI и выводит время по этапам в JSON.
+
+namespace {
+
+struct Scenario {
+    QString name;
+    int smallFiles;     // 512 Б - 8 КБ
+    int mediumFiles;    // 64 КБ - 1 МБ
+    int hugeFiles;
+    qint64 hugeFileSize;
+};
+
+// Блок данных "похожих на исходники": слова из словаря вперемешку со случайными байтами,
+// чтобы степень сжатия была близка к реальным пакетам
+QByteArray makeContentBlock(quint32 seed, int size) {
+    static const char* const words[] = {
+        "static ", "int ", "return ", "struct ", "const ", "void ", "if (", ") {\n", "}\n",
+        "#include ", "<stdio.h>\n", "buffer", "length", "0x7f", "NULL", "/* comment */\n", "    "
+    };
+    QRandomGenerator random(seed);
+    QByteArray block;
+    block.reserve(size + 32);
+    while (block.size() < size) {
+        if (random.bounded(16) == 0) {
+            const quint32 noise = random.generate();
+            block.append(reinterpret_cast<const char*>(&noise), sizeof(noise));
+        } else {
+            block.append(words[random.bounded(int(sizeof(words) / sizeof(words[0])))]);
+        }
+    }
+    block.truncate(size);
+    return block;
+}
+
+bool generateArchive(const Scenario& scenario, bool blockGzip, const QString& path, qint64* uncompressedSize, QString* error) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = file.errorString();
+        return false;
+    }
+    GzipWriter gzip(&file, 6);
+    BgzfWriter bgzf(&file, 6);
+    TarWriter tar([&](const char* data, qint64 size) { return blockGzip ? bgzf.write(data, size) : gzip.write(data, size); });
+
+    const QByteArray pattern = makeContentBlock(42, 1024 * 1024);
+    QRandomGenerator random(7);
+    const QString root = scenario.name + '/';
+    bool ok = tar.addDirectory(root);
+
+    // Мелкие файлы: по 100 в каталоге, три уровня вложенности, как в дереве исходников
+    for (int i = 0; ok && i < scenario.smallFiles; ++i) {
+        const QString dir = root + QString("src/d%1/d%2/").arg(i / 10000).arg((i / 100) % 100);
+        if (i % 100 == 0) {
+            ok = tar.addDirectory(dir);
+        }
+        const int size = 512 + random.bounded(8 * 1024 - 512);
+        const int offset = random.bounded(pattern.size() - size);
+        ok = ok && tar.addFile(dir + QString("file%1.c").arg(i), pattern.mid(offset, size));
+    }
+    if (ok && scenario.mediumFiles > 0) {
+        ok = tar.addDirectory(root + "lib/");
+    }
+    for (int i = 0; ok && i < scenario.mediumFiles; ++i) {
+        const int size = 64 * 1024 + random.bounded(1024 * 1024 - 64 * 1024);
+        ok = tar.addFile(root + QString("lib/module%1.o").arg(i), makeContentBlock(1000 + i, size));
+    }
+    if (ok && scenario.hugeFiles > 0) {
+        ok = tar.addDirectory(root + "data/");
+    }
+    for (int i = 0; ok && i < scenario.hugeFiles; ++i) {
+        ok = tar.beginFile(root + QString("data/blob%1.bin").arg(i), scenario.hugeFileSize);
+        for (qint64 written = 0; ok && written < scenario.hugeFileSize; written += pattern.size()) {
+            ok = tar.writeData(pattern.constData(), qMin<qint64>(pattern.size(), scenario.hugeFileSize - written));
+        }
+        ok = ok && tar.endFile();
+    }
+    ok = ok && tar.finish() && (blockGzip ? bgzf.finish() : gzip.finish());
+    if (!ok) {
+        const QString writerError = blockGzip ? bgzf.errorString() : gzip.errorString();
+        *error = writerError.isEmpty() ? QString("Ошибка записи архива") : writerError;
+        return false;
+    }
+    *uncompressedSize = tar.bytesWritten();
+    return true;
+}
+
+QJsonObject runScenario(PackageManager& manager, const Scenario& scenario, const QString& format,
+                        const QString& archivePath, qint64 uncompressedSize, int run) {
+    PackageInfo package;
+    package.id = QString("bench-%1-%2").arg(scenario.name, format);
+    package.displayName = package.id;
+    package.resourcePath = archivePath;
+    package.targetSubDir = QString("%1-%2-run%3").arg(scenario.name, format).arg(run);
+
+    QEventLoop loop;
+    int jobId = 0;
+    InstallProgress finalProgress;
+    bool haveFinalProgress = false;
+    bool success = false;
+    QString message;
+    // Итоговый снимок PackageManager снимает со счётчиков уже завершённого задания, до
+    // installationFinished; промежуточные снимки по таймеру могут не застать конец установки
+    auto progressConnection = QObject::connect(&manager, &PackageManager::progressChanged,
+                                               [&](const InstallProgress& progress) {
+        if (progress.jobId == jobId && progress.phase == InstallPhase::Finished) {
+            finalProgress = progress;
+            haveFinalProgress = true;
+        }
+    });
+    auto finishedConnection = QObject::connect(&manager, &PackageManager::installationFinished,
+                                               [&](const QString&, bool ok, const QString& text) {
+        success = ok;
+        message = text;
+        loop.quit();
+    });
+
+    QElapsedTimer wall;
+    wall.start();
+    jobId = manager.installPackage(package);
+    if (jobId != 0) {
+        loop.exec();
+    }
+    const qint64 wallNs = wall.nsecsElapsed();
+    QObject::disconnect(progressConnection);
+    QObject::disconnect(finishedConnection);
+
+    const double ms = 1e-6;
+    QJsonObject phases;
+    phases["resourceRead"] = finalProgress.openNs * ms;
+    phases["decompress"] = finalProgress.decodeNs * ms;
+    phases["fileCreation"] = finalProgress.writeNs * ms;
+    phases["finalFlush"] = finalProgress.finalizeNs * ms;
+
+    QJsonObject result;
+    result["scenario"] = scenario.name;
+    result["format"] = format;
+    result["run"] = run;
+    result["success"] = success && haveFinalProgress;
+    if (!success) {
+        result["error"] = message;
+    } else if (!haveFinalProgress) {
+        result["error"] = QString("Нет итогового снимка прогресса установки");
+    }
+    result["archiveBytes"] = QFileInfo(archivePath).size();
+    result["uncompressedBytes"] = uncompressedSize;
+    result["entries"] = finalProgress.entries;
+    result["wallMs"] = wallNs * ms;
+    result["phasesMs"] = phases;
+    result["throughputMBps"] = wallNs > 0 ? (uncompressedSize / (1024.0 * 1024.0)) / (wallNs * 1e-9) : 0.0;
+
+    QDir(manager.installPathFor(package)).removeRecursively();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Install pipeline benchmark");
+    parser.addHelpOption();
+    parser.addOption({{"s", "scale"}, "Scale factor for file counts and sizes (default 1).", "factor", "1"});
+    parser.addOption({{"n", "repeat"}, "Runs per scenario (default 3).", "count", "3"});
+    parser.addOption({{"o", "output"}, "Write JSON results to a file instead of stdout.", "file"});
+    parser.addOption({"scenario", "Run only the named scenario (many-small, few-huge, mixed).", "name"});
+    parser.addOption({"workdir", "Directory for generated archives and installs (default: temporary).", "dir"});
+    parser.process(app);
+
+    const double scale = qMax(0.01, parser.value("scale").toDouble());
+    const int repeat = qMax(1, parser.value("repeat").toInt());
+
+    const QList<Scenario> scenarios = {
+        {"many-small", int(20000 * scale), 0, 0, 0},
+        {"few-huge", 0, 0, 4, qint64(64 * 1024 * 1024 * scale)},
+        {"mixed", int(5000 * scale), int(200 * scale), 2, qint64(32 * 1024 * 1024 * scale)},
+    };
+
+    QTemporaryDir tempDir;
+    const QString workDir = parser.isSet("workdir") ? parser.value("workdir") : tempDir.path();
+    QDir().mkpath(workDir);
+
+    PackageManager manager;
+    manager.setInstallRoot(workDir + "/installed");
+    // Сценарии измеряются по одному, чтобы цифры не смешивались
+    manager.setMaxConcurrentInstalls(1);
+
+    QJsonArray results;
+    for (const Scenario& scenario : scenarios) {
+        if (parser.isSet("scenario") && parser.value("scenario") != scenario.name) {
+            continue;
+        }
+        // BGZF - тот же tar, но путь распаковки другой: параллельный ParallelInflater
+        for (const bool blockGzip : {false, true}) {
+            const QString format = blockGzip ? "bgzf" : "gzip";
+            const QString archivePath = workDir + '/' + scenario.name + '-' + format + ".tar.gz";
+            qint64 uncompressedSize = 0;
+            QString error;
+            if (!generateArchive(scenario, blockGzip, archivePath, &uncompressedSize, &error)) {
+                QTextStream(stderr) << "Failed to generate " << scenario.name << " (" << format << "): " << error << '\n';
+                return 1;
+            }
+            for (int run = 0; run < repeat; ++run) {
+                results.append(runScenario(manager, scenario, format, archivePath, uncompressedSize, run));
+            }
+            QFile::remove(archivePath);
+        }
+    }
+
+    QJsonObject report;
+    report["benchmark"] = "install-pipeline";
+    report["qtVersion"] = QString(qVersion());
+    report["cpuCount"] = QThread::idealThreadCount();
+    report["scale"] = scale;
+    report["results"] = results;
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    if (parser.isSet("output")) {
+        QFile output(parser.value("output"));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate) || output.write(json) != json.size()) {
+            QTextStream(stderr) << "Failed to write " << parser.value("output") << '\n';
+            return 1;
+        }
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    for (const QJsonValue& value : results) {
+        if (!value.toObject().value("success").toBool()) {
+            return 1;
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -1,19 +1,28 @@
 #include "MainWindow.h"
+#include "ResourceBundles.h"
+#include "CliInstaller.h"
+#include "Trace.h"
 
 #include <QApplication>
 #include <QDebug>
-#include <QFile>
-#include <QDir>
-#include <QResource>
 
 int main(int argc, char *argv[]) {
+    // Headless-режим: QApplication и окна не создаются вовсе
+    if (CliInstaller::isCliInvocation(argc, argv)) {
+        return CliInstaller::run(argc, argv);
+    }
+
     QApplication a(argc, argv);
 
-    QString resourcePath = QCoreApplication::applicationDirPath() + "/packages.rcc";
+    // Бандлы с архивами (packages.rcc) лежат рядом с исполняемым файлом и подключаются лениво
+    ResourceBundles::setSearchPath(QCoreApplication::applicationDirPath());
+    Trace::configureFromEnvironment();
 
     MainWindow w;
     w.resize(800, 600);
     w.setWindowTitle("Stacked Layout Example");
     w.show();
-    return a.exec();
+    const int exitCode = a.exec();
+    Trace::writeRequested();
+    return exitCode;
 }
\ No newline at end of file
@@ -0,0 +1,1242 @@
+#include "ArchiveExtractor.h"
+#include "FunctionRunnable.h"
+#include "ParallelInflater.h"
+#include "StreamDecoder.h"
+#include "TarFormat.h"
+#include "Trace.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QResource>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <cstring>
+#include <limits>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using TarFormat::parseNumeric;
+using TarFormat::fieldString;
+using TarFormat::isZeroBlock;
+using TarFormat::verifyChecksum;
+
+constexpr int kTarBlockSize = TarFormat::kBlockSize;
+constexpr int kInflateChunk = 256 * 1024;
+// Сжатые данные подаются декодеру порциями
+constexpr qint64 kInputSlice = 4 * 1024 * 1024;
+// Файлы не больше этого размера буферизуются целиком и пишутся пулом потоков.
+// Они собираются в пачки в буферах такого же размера: одна задача пула на пачку
+constexpr qint64 kMaxBufferedFileSize = 1024 * 1024;
+// Бюджет памяти конвейера по умолчанию и наименьший допустимый
+constexpr qint64 kDefaultMemoryBudget = 128 * 1024 * 1024;
+constexpr qint64 kMinMemoryBudget = 8 * 1024 * 1024;
+// Контрольная точка сохраняется не чаще, чем через столько байт tar
+constexpr qint64 kCheckpointInterval = 64 * 1024 * 1024;
+// Минимальная "стоимость" файла в пачке и очереди записи, чтобы пустые файлы не копились без предела
+constexpr qint64 kMinFileCost = 4096;
+
+// Несжатый ресурс Qt: данные уже лежат в памяти (в бинарнике или в mmap .rcc)
+bool isResourceInPlace(const QResource& resource) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    return resource.isValid() && resource.compressionAlgorithm() == QResource::NoCompression && resource.data();
+#else
+    return resource.isValid() && !resource.isCompressed() && resource.data();
+#endif
+}
+
+// Быстрая проверка (как в rsync): файл на диске совпадает с записью индекса по размеру и времени
+bool matchesOnDisk(const QString& path, const InstalledFile& file) {
+    const QFileInfo info(path);
+    return !info.isSymLink() && info.isFile() && info.size() == file.size &&
+           info.lastModified().toSecsSinceEpoch() == file.mtime;
+}
+
+} // namespace
+
+ArchiveExtractor::ArchiveExtractor(const QString& targetDir)
+    : m_tree(targetDir),
+      m_decoderThreads(QThread::idealThreadCount()) {
+    m_outBuffer.resize(kInflateChunk);
+    m_writerPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    m_verifyPool.setMaxThreadCount(1);
+    setMemoryBudget(kDefaultMemoryBudget);
+}
+
+ArchiveExtractor::~ArchiveExtractor() {
+    // Задачи пула записи обращаются к членам объекта
+    m_writerPool.waitForDone();
+    m_verifyPool.waitForDone();
+}
+
+void ArchiveExtractor::setExpectedDigests(const QByteArray& archiveSha256, const QHash<QString, QByteArray>& entrySha256) {
+    m_expectedArchiveDigest = archiveSha256;
+    m_expectedEntryDigests = entrySha256;
+}
+
+void ArchiveExtractor::setJournal(ExtractionJournal* journal, const ExtractionCheckpoint& resumeFrom) {
+    m_journal = journal;
+    m_resume = resumeFrom;
+}
+
+void ArchiveExtractor::setBaseline(const QString& baseDir, const InstalledIndex* index) {
+    // Без жёстких ссылок переиспользовать нечего: копия стоила бы не меньше записи
+    const bool usable = index && !index->isEmpty() && OutputTree::supportsExternalLinks();
+    m_baselineDir = usable ? QDir::cleanPath(baseDir) : QString();
+    m_baselineIndex = usable ? index : nullptr;
+}
+
+void ArchiveExtractor::setDeltaBase(const QString& baseDir, const InstalledIndex* index) {
+    m_deltaBaseDir = QDir::cleanPath(baseDir);
+    m_deltaBaseIndex = index;
+}
+
+void ArchiveExtractor::setThreadCounts(int decoderThreads, int writerThreads) {
+    m_decoderThreads = qMax(1, decoderThreads);
+    m_writerThreadsEnabled = writerThreads > 0;
+    m_writerPool.setMaxThreadCount(qMax(1, writerThreads));
+}
+
+void ArchiveExtractor::setMemoryBudget(qint64 bytes) {
+    // Половина - пачкам мелких файлов, по четверти - распакованным блокам BGZF и результатам
+    // патчей. Буферы декодера и записи крупного файла малы и не зависят от бюджета
+    m_memoryBudget = qMax(bytes, kMinMemoryBudget);
+    m_batchPool.reset(new BufferPool(kMaxBufferedFileSize, static_cast<int>(m_memoryBudget / 2 / kMaxBufferedFileSize)));
+}
+
+bool ArchiveExtractor::extract(const QString& archivePath) {
+    PACKMAN_TRACE_SCOPE("extract");
+    QElapsedTimer phaseTimer;
+    phaseTimer.start();
+
+    QString error;
+    if (!m_tree.open(&error)) {
+        return fail(error);
+    }
+    m_uncheckedEntries = m_expectedEntryDigests;
+
+    bool ok = false;
+
+    // 1. Несжатый ресурс Qt: данные уже лежат в памяти (в бинарнике или в mmap .rcc)
+    QResource resource(archivePath);
+    m_counters->setPhase(InstallPhase::Opening);
+    if (isResourceInPlace(resource)) {
+        m_counters->bytesTotal.store(resource.size());
+        applyCheckpoint(archivePath, resource.size());
+        m_counters->openNs.fetch_add(phaseTimer.nsecsElapsed());
+        m_counters->setPhase(InstallPhase::Extracting);
+        // Данные ресурса принадлежат Qt (rcc может лежать и в куче) - страницы не отпускаются
+        ok = extractMapped(resource.data(), resource.size(), false);
+    } else {
+        QFile archive(archivePath);
+        if (!archive.open(QIODevice::ReadOnly)) {
+            return fail(QString("Не удалось открыть архив '%1': %2").arg(archivePath, archive.errorString()));
+        }
+        // 2. Обычный файл: отображаем в память. 3. Иначе (сжатый rcc-ресурс) - потоковое чтение
+        uchar* mapped = nullptr;
+        if (archive.size() > 0) {
+            PACKMAN_TRACE_SCOPE("archive.map", archive.size());
+            mapped = archive.map(0, archive.size());
+        }
+        m_counters->bytesTotal.store(archive.size());
+        applyCheckpoint(archivePath, archive.size());
+        m_counters->openNs.fetch_add(phaseTimer.nsecsElapsed());
+        m_counters->setPhase(InstallPhase::Extracting);
+        if (mapped) {
+            ok = extractMapped(mapped, archive.size(), true);
+            archive.unmap(mapped);
+        } else {
+            ok = extractFromDevice(&archive);
+        }
+    }
+
+    m_file.abort();
+    // Все файлы из пула должны быть записаны до применения прав каталогов
+    m_counters->setPhase(InstallPhase::Finalizing);
+    PACKMAN_TRACE_SCOPE("finalize");
+    phaseTimer.restart();
+    drainWriters();
+    ok = ok && checkWriters() && linkDeltaBase() && verifyDigests();
+    if (ok) {
+        applyDirectoryPermissions();
+    }
+    m_counters->finalizeNs.fetch_add(phaseTimer.nsecsElapsed());
+    return ok;
+}
+
+bool ArchiveExtractor::extractEntries(const QString& archivePath, const ArchiveIndex& index, const QList<ArchiveEntry>& entries) {
+    PACKMAN_TRACE_SCOPE("extract.entries", entries.size());
+    QElapsedTimer phaseTimer;
+    phaseTimer.start();
+
+    QString error;
+    if (!m_tree.open(&error)) {
+        return fail(error);
+    }
+    m_expectedArchiveDigest.clear();
+    for (const ArchiveEntry& entry : entries) {
+        const auto digest = m_expectedEntryDigests.constFind(entry.path);
+        if (digest != m_expectedEntryDigests.constEnd()) {
+            m_uncheckedEntries.insert(entry.path, digest.value());
+        }
+    }
+
+    // Нужен произвольный доступ: ресурс в памяти или отображённый файл
+    m_counters->setPhase(InstallPhase::Opening);
+    QResource resource(archivePath);
+    QFile archive(archivePath);
+    const uchar* data = nullptr;
+    qint64 size = 0;
+    if (isResourceInPlace(resource)) {
+        data = resource.data();
+        size = resource.size();
+    } else if (archive.open(QIODevice::ReadOnly) && archive.size() > 0) {
+        data = archive.map(0, archive.size());
+        size = archive.size();
+    }
+    if (!data) {
+        return fail(QString("Архив '%1' недоступен для выборочной распаковки").arg(archivePath));
+    }
+    if (!index.isSeekable() || index.archiveSize() != size) {
+        return fail(QString("Индекс не соответствует архиву '%1'").arg(archivePath));
+    }
+
+    // Соседние записи распаковываются одним проходом
+    QList<QPair<qint64, qint64>> ranges;
+    for (const ArchiveEntry& entry : entries) {
+        if (!ranges.isEmpty() && ranges.last().second == entry.offset) {
+            ranges.last().second = entry.end;
+        } else {
+            ranges.append(qMakePair(entry.offset, entry.end));
+        }
+    }
+    qint64 compressedTotal = 0;
+    for (const auto& range : qAsConst(ranges)) {
+        compressedTotal += index.compressedEnd(range.second) - index.blockFor(range.first).compressedOffset;
+    }
+    m_counters->bytesTotal.store(compressedTotal);
+    m_counters->openNs.fetch_add(phaseTimer.nsecsElapsed());
+    m_counters->setPhase(InstallPhase::Extracting);
+
+    bool ok = true;
+    for (const auto& range : qAsConst(ranges)) {
+        if (!extractRange(data, size, index.blockFor(range.first), range.first, range.second)) {
+            ok = false;
+            break;
+        }
+    }
+
+    m_file.abort();
+    m_counters->setPhase(InstallPhase::Finalizing);
+    PACKMAN_TRACE_SCOPE("finalize");
+    phaseTimer.restart();
+    drainWriters();
+    ok = ok && checkWriters() && verifyDigests();
+    if (ok) {
+        applyDirectoryPermissions();
+    }
+    m_counters->finalizeNs.fetch_add(phaseTimer.nsecsElapsed());
+    return ok;
+}
+
+bool ArchiveExtractor::extractRange(const uchar* data, qint64 size, const ArchiveIndex::Block& block, qint64 begin, qint64 end) {
+    PACKMAN_TRACE_SCOPE("extract.range", end - begin);
+    // Блоки BGZF - независимые члены gzip: декодер начинает с начала блока
+    QString error;
+    m_decoder = StreamDecoder::create(ArchiveFormat::Gzip, data, size, &error);
+    if (!m_decoder) {
+        return fail(error);
+    }
+    m_memberEnded = false;
+    m_tarFinished = false;
+    m_tarOffset = begin;
+
+    qint64 input = block.compressedOffset;
+    qint64 position = block.tarOffset;
+    while (position < end) {
+        if (isCancelled()) {
+            return false;
+        }
+        if (m_memberEnded) {
+            if (input >= size || !m_decoder->startsMember(data + input, size - input) || !m_decoder->reset()) {
+                return fail("Архив обрезан: запись из индекса выходит за конец архива");
+            }
+            m_memberEnded = false;
+        }
+
+        qint64 consumed = 0;
+        qint64 produced = 0;
+        StreamDecoder::Status status;
+        {
+            PhaseTimer timer(m_counters->decodeNs);
+            PACKMAN_TRACE_SCOPE("decode");
+            status = m_decoder->decode(data + input, qMin(kInputSlice, size - input), &consumed,
+                                       m_outBuffer.data(), m_outBuffer.size(), &produced);
+        }
+        m_counters->addIn(consumed);
+        input += consumed;
+        if (status == StreamDecoder::Status::Error) {
+            return fail(QString("Архив повреждён: %1").arg(m_decoder->errorString()));
+        }
+        if (status == StreamDecoder::Status::StreamEnd) {
+            m_memberEnded = true;
+        }
+        // Начало блока до записи и всё после конца диапазона отбрасываются
+        const qint64 from = qBound<qint64>(0, begin - position, produced);
+        const qint64 to = qBound<qint64>(0, end - position, produced);
+        if (to > from && !consumeTar(m_outBuffer.constData() + from, to - from)) {
+            return false;
+        }
+        position += produced;
+        if (consumed == 0 && produced == 0 && status == StreamDecoder::Status::Ok) {
+            return fail("Архив обрезан: запись из индекса выходит за конец архива");
+        }
+    }
+    // Диапазон заканчивается на границе записи - иначе индекс построен для другого архива
+    if (m_headerFill != 0 || m_entryRemaining > 0 || m_entryPadding > 0) {
+        return fail("Индекс не соответствует архиву: граница записи не совпала");
+    }
+    // CRC блока проверяется в его конце: последний блок дочитывается, остаток отбрасывается
+    while (!m_memberEnded) {
+        qint64 consumed = 0;
+        qint64 produced = 0;
+        const StreamDecoder::Status status = m_decoder->decode(data + input, qMin(kInputSlice, size - input), &consumed,
+                                                               m_outBuffer.data(), m_outBuffer.size(), &produced);
+        m_counters->addIn(consumed);
+        input += consumed;
+        if (status == StreamDecoder::Status::Error) {
+            return fail(QString("Архив повреждён: %1").arg(m_decoder->errorString()));
+        }
+        if (status == StreamDecoder::Status::StreamEnd) {
+            m_memberEnded = true;
+        } else if (consumed == 0 && produced == 0) {
+            return fail("Архив обрезан: запись из индекса выходит за конец архива");
+        }
+    }
+    return true;
+}
+
+void ArchiveExtractor::applyCheckpoint(const QString& archivePath, qint64 archiveSize) {
+    m_archivePath = archivePath;
+    m_archiveSize = archiveSize;
+    // Отпечаток нужен только журналу: им точка привязывается к содержимому архива
+    m_archiveFingerprint = m_journal ? ExtractionJournal::fingerprint(archivePath, m_expectedArchiveDigest) : QByteArray();
+    if (!m_resume.isValid() || m_resume.archivePath != archivePath || m_resume.archiveSize != archiveSize ||
+        m_resume.archiveFingerprint.isEmpty() || m_resume.archiveFingerprint != m_archiveFingerprint) {
+        m_resume = ExtractionCheckpoint();
+        return;
+    }
+    // Декодирование начинается с члена, в котором лежит контрольная точка;
+    // всё, что было до неё, восстанавливается из журнала
+    m_inputOffset = m_restartInput = m_resume.restartInput;
+    m_tarOffset = m_restartOutput = m_resume.restartOutput;
+    m_resumeOffset = m_lastCheckpoint = m_resume.resumeOutput;
+    m_entriesWritten = m_resume.entries;
+    m_counters->entries.fetch_add(m_resume.entries);
+    m_directoryModes = m_resume.directoryModes;
+    m_verifiedEntries = m_resume.verifiedEntries;
+    for (const QString& path : qAsConst(m_verifiedEntries)) {
+        m_uncheckedEntries.remove(path);
+    }
+}
+
+void ArchiveExtractor::restartFromBeginning() {
+    // Записи до контрольной точки по-прежнему пропускаются, меняется только место начала декодирования
+    m_inputOffset = m_restartInput = 0;
+    m_tarOffset = m_restartOutput = 0;
+}
+
+bool ArchiveExtractor::writeCheckpoint(qint64 headerOffset) {
+    // Точка фиксируется, только когда всё до неё действительно записано
+    PACKMAN_TRACE_SCOPE("checkpoint", headerOffset);
+    drainWriters();
+    if (!checkWriters()) {
+        return false;
+    }
+    ExtractionCheckpoint checkpoint;
+    checkpoint.archivePath = m_archivePath;
+    checkpoint.archiveSize = m_archiveSize;
+    checkpoint.archiveFingerprint = m_archiveFingerprint;
+    checkpoint.restartInput = m_restartInput;
+    checkpoint.restartOutput = m_restartOutput;
+    checkpoint.resumeOutput = headerOffset;
+    checkpoint.entries = m_entriesWritten;
+    checkpoint.directoryModes = m_directoryModes;
+    checkpoint.verifiedEntries = m_verifiedEntries;
+    // Журнал необязателен: без него прерванная установка просто начнётся заново
+    m_journal->save(checkpoint);
+    m_lastCheckpoint = headerOffset;
+    return true;
+}
+
+bool ArchiveExtractor::isCancelled() {
+    if (!m_counters->cancelRequested.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    fail("Установка отменена");
+    return true;
+}
+
+bool ArchiveExtractor::extractMapped(const uchar* data, qint64 size, bool ownMapping) {
+    m_releaseInput = ownMapping;
+    // Архив целиком в памяти: его сумма считается в отдельном потоке параллельно распаковке,
+    // по тем же страницам, так что проверка почти не добавляет времени
+    m_inputHashed.store(m_expectedArchiveDigest.isEmpty() ? size : 0);
+    if (!m_expectedArchiveDigest.isEmpty()) {
+        InstallCounters* counters = m_counters;
+        m_verifyPool.start(new FunctionRunnable([this, counters, data, size]() {
+            PACKMAN_TRACE_SCOPE("hash.archive", size);
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            for (qint64 offset = 0; offset < size && !counters->cancelRequested.load(std::memory_order_relaxed); offset += kInputSlice) {
+                const qint64 length = qMin(kInputSlice, size - offset);
+                hash.addData(reinterpret_cast<const char*>(data) + offset, static_cast<int>(length));
+                m_inputHashed.store(offset + length);
+            }
+            m_archiveDigest = hash.result();
+        }));
+    }
+    const bool ok = extractFromMemory(data, size);
+    // Данные отображения перестают быть доступны после возврата
+    m_verifyPool.waitForDone();
+    return ok;
+}
+
+bool ArchiveExtractor::extractFromMemory(const uchar* data, qint64 size) {
+    // BGZF: члены gzip независимы, разжимаем их параллельно
+    // При продолжении с контрольной точки декодирование начинается с члена, в котором она лежит
+    m_counters->addIn(m_inputOffset);
+    const uchar* start = data + m_inputOffset;
+    const qint64 remaining = size - m_inputOffset;
+
+    const bool gzipFormat = m_format == ArchiveFormat::Gzip || m_format == ArchiveFormat::Auto;
+    if (gzipFormat && m_decoderThreads > 1 && ParallelInflater::isBlockGzip(start, remaining)) {
+        ParallelInflater inflater(m_decoderThreads, m_memoryBudget / 4);
+        const bool inflated = inflater.run(start, remaining, [this, data](const char* chunk, qint64 length, qint64 compressedLength) {
+            m_counters->addIn(compressedLength);
+            if (isCancelled() || !consumeTar(chunk, length)) {
+                return false;
+            }
+            // Порции BGZF состоят из целых членов: конец порции - точка перезапуска
+            m_inputOffset += compressedLength;
+            m_restartInput = m_inputOffset;
+            m_restartOutput = m_tarOffset;
+            releaseInput(data, m_inputOffset);
+            return !m_tarFinished;
+        });
+        m_counters->decodeNs.fetch_add(inflater.decodeNanoseconds());
+        if (!inflated) {
+            return fail(inflater.errorString());
+        }
+        if (!m_error.isEmpty()) {
+            return false;
+        }
+        m_memberEnded = true;
+        return finishInput();
+    }
+
+    for (qint64 offset = 0; offset < remaining && !m_tarFinished; offset += kInputSlice) {
+        if (!decodeInput(start + offset, qMin(kInputSlice, remaining - offset))) {
+            return false;
+        }
+        releaseInput(data, m_inputOffset);
+    }
+    return finishInput();
+}
+
+void ArchiveExtractor::releaseInput(const uchar* data, qint64 consumed) {
+#ifdef Q_OS_LINUX
+    if (!m_releaseInput) {
+        return;
+    }
+    // Разобранные страницы отображения больше не читаются; без этого к концу распаковки
+    // в памяти процесса оседает весь архив. Страницы, которые ещё не захэшированы, остаются
+    const qint64 upTo = qMin(consumed, m_inputHashed.load());
+    const quintptr pageSize = static_cast<quintptr>(sysconf(_SC_PAGESIZE));
+    const quintptr begin = (reinterpret_cast<quintptr>(data) + m_inputReleased + pageSize - 1) & ~(pageSize - 1);
+    const quintptr end = (reinterpret_cast<quintptr>(data) + upTo) & ~(pageSize - 1);
+    if (end >= begin + kInputSlice) {
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+        m_inputReleased = static_cast<qint64>(end - reinterpret_cast<quintptr>(data));
+    }
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(consumed);
+#endif
+}
+
+bool ArchiveExtractor::extractFromDevice(QIODevice* device) {
+    // Поток читается с начала: сумма архива нужна по всем байтам, а сжатый ресурс Qt
+    // при перемотке всё равно распаковывается заново
+    restartFromBeginning();
+    const bool hashArchive = !m_expectedArchiveDigest.isEmpty();
+    m_archiveHash.reset();
+    QByteArray chunk(kInflateChunk, Qt::Uninitialized);
+    // Для суммы архив дочитывается до конца, даже если tar закончился раньше
+    while (!m_tarFinished || hashArchive) {
+        const qint64 bytesRead = device->read(chunk.data(), chunk.size());
+        if (bytesRead < 0) {
+            return fail(QString("Ошибка чтения архива: %1").arg(device->errorString()));
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        if (hashArchive) {
+            m_archiveHash.addData(chunk.constData(), static_cast<int>(bytesRead));
+        }
+        if (!m_tarFinished && !decodeInput(reinterpret_cast<const uchar*>(chunk.constData()), bytesRead)) {
+            return false;
+        }
+    }
+    if (hashArchive) {
+        m_archiveDigest = m_archiveHash.result();
+    }
+    return finishInput();
+}
+
+bool ArchiveExtractor::decodeInput(const uchar* data, qint64 size) {
+    if (!m_decoder) {
+        // Декодер выбирается по формату пакета или по сигнатуре первой порции
+        QString error;
+        m_decoder = StreamDecoder::create(m_format, data, size, &error);
+        if (!m_decoder) {
+            return fail(error);
+        }
+        m_detectedFormat = m_format == ArchiveFormat::Auto ? StreamDecoder::detect(data, size) : m_format;
+    }
+
+    while (size > 0 && !m_tarFinished) {
+        if (isCancelled()) {
+            return false;
+        }
+        if (m_memberEnded) {
+            // Следующий член gzip / кадр zstd / поток xz. Всё прочее - мусор в конце файла
+            if (!m_decoder->startsMember(data, size) || !m_decoder->reset()) {
+                break;
+            }
+            m_memberEnded = false;
+            m_restartInput = m_inputOffset;
+            m_restartOutput = m_tarOffset;
+        }
+
+        qint64 consumed = 0;
+        qint64 produced = 0;
+        StreamDecoder::Status status;
+        {
+            PhaseTimer timer(m_counters->decodeNs);
+            TraceScope span("decode");
+            status = m_decoder->decode(data, size, &consumed, m_outBuffer.data(), m_outBuffer.size(), &produced);
+            span.setValue(produced);
+        }
+        m_counters->addIn(consumed);
+        m_inputOffset += consumed;
+        data += consumed;
+        size -= consumed;
+
+        if (status == StreamDecoder::Status::Error) {
+            return fail(QString("Архив повреждён: %1").arg(m_decoder->errorString()));
+        }
+        if (status == StreamDecoder::Status::StreamEnd) {
+            m_memberEnded = true;
+        }
+        if (produced > 0 && !consumeTar(m_outBuffer.constData(), produced)) {
+            return false;
+        }
+        if (consumed == 0 && produced == 0 && status == StreamDecoder::Status::Ok) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool ArchiveExtractor::finishInput() {
+    if (m_tarFinished) {
+        return true;
+    }
+    // Несжатый tar не имеет собственного признака конца потока
+    if (!m_memberEnded && m_detectedFormat != ArchiveFormat::Tar) {
+        return fail("Архив обрезан: сжатый поток завершился раньше времени");
+    }
+    // Некоторые упаковщики не пишут завершающие нулевые блоки - допустимо, если запись не оборвана
+    if (m_headerFill != 0 || m_entryRemaining > 0 || m_entryPadding > 0) {
+        return fail("Архив обрезан: последняя запись tar неполная");
+    }
+    return true;
+}
+
+bool ArchiveExtractor::consumeTar(const char* data, qint64 size) {
+    m_counters->addOut(size);
+    while (size > 0 && !m_tarFinished) {
+        // После продолжения декодирование идёт с начала члена сжатого потока, обычно посреди
+        // чьих-то данных. Всё до заголовка контрольной точки уже на диске и не разбирается
+        if (m_tarOffset < m_resumeOffset) {
+            const qint64 take = qMin(size, m_resumeOffset - m_tarOffset);
+            m_tarOffset += take;
+            data += take;
+            size -= take;
+            continue;
+        }
+        if (m_entryRemaining > 0) {
+            const qint64 take = qMin(size, m_entryRemaining);
+            if (!consumeEntryData(data, take)) {
+                return false;
+            }
+            m_tarOffset += take;
+            data += take;
+            size -= take;
+            m_entryRemaining -= take;
+            if (m_entryRemaining == 0 && !finishEntry()) {
+                return false;
+            }
+            continue;
+        }
+
+        if (m_entryPadding > 0) {
+            const qint64 take = qMin(size, m_entryPadding);
+            m_tarOffset += take;
+            data += take;
+            size -= take;
+            m_entryPadding -= take;
+            continue;
+        }
+
+        const int take = static_cast<int>(qMin<qint64>(size, kTarBlockSize - m_headerFill));
+        std::memcpy(m_header + m_headerFill, data, take);
+        m_headerFill += take;
+        m_tarOffset += take;
+        data += take;
+        size -= take;
+        if (m_headerFill == kTarBlockSize) {
+            m_headerFill = 0;
+            if (!handleHeader(m_header)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ArchiveExtractor::handleHeader(const char* header) {
+    if (isCancelled() || !checkWriters()) {
+        return false;
+    }
+    if (isZeroBlock(header)) {
+        m_tarFinished = true;
+        return true;
+    }
+    if (!verifyChecksum(header)) {
+        return fail("Архив повреждён: неверная контрольная сумма заголовка tar");
+    }
+
+    const char type = header[156];
+    const qint64 size = parseNumeric(header + 124, 12);
+    m_entryRemaining = size;
+    m_entryPadding = (kTarBlockSize - size % kTarBlockSize) % kTarBlockSize;
+
+    const qint64 headerOffset = m_tarOffset - kTarBlockSize;
+    // Точка допустима только на заголовке, не продолжающем служебную запись (GNU longname, pax),
+    // и не раньше начала текущего члена сжатого потока
+    if (m_journal && m_pendingPath.isEmpty() && m_pendingLink.isEmpty() && m_restartOutput <= headerOffset &&
+        headerOffset - m_lastCheckpoint >= kCheckpointInterval && !writeCheckpoint(headerOffset)) {
+        return false;
+    }
+
+    // Служебные записи: их данные относятся к следующему заголовку
+    if (type == 'L' || type == 'K' || type == 'x') {
+        m_entryKind = type == 'L' ? EntryKind::LongName : (type == 'K' ? EntryKind::LongLink : EntryKind::PaxHeader);
+        return startInMemoryEntry(size, "Служебная запись tar") && (size > 0 || finishEntry());
+    }
+    if (type == 'g') {
+        m_entryKind = EntryKind::Skip;
+        return size > 0 || finishEntry();
+    }
+
+    QString entryPath = m_pendingPath;
+    if (entryPath.isEmpty()) {
+        entryPath = TarFormat::headerPath(header);
+    }
+    QString linkTarget = m_pendingLink.isEmpty() ? fieldString(header + 157, 100) : m_pendingLink;
+    m_pendingPath.clear();
+    m_pendingLink.clear();
+
+    const int mode = static_cast<int>(parseNumeric(header + 100, 8)) & 07777;
+    const QString targetPath = resolveTargetPath(entryPath);
+    if (targetPath.isNull()) {
+        return fail(QString("Архив содержит недопустимый путь: '%1'").arg(entryPath));
+    }
+
+    PhaseTimer writeTimer(m_counters->writeNs);
+    PACKMAN_TRACE_SCOPE("entry.header", size);
+    m_entryKind = EntryKind::Skip;
+    switch (type) {
+    case '0':
+    case '\0':
+    case '7':
+        // Служебные записи дельта-пакета: манифест и патчи копятся в памяти
+        if (targetPath == DeltaManifest::entryName() || targetPath.startsWith(DeltaManifest::patchPrefix())) {
+            if (!m_deltaBaseIndex) {
+                return fail("Дельта-пакет можно применить только поверх установленной базовой версии");
+            }
+            m_entryKind = targetPath == DeltaManifest::entryName() ? EntryKind::Delta : EntryKind::Patch;
+            m_filePath = targetPath.mid(DeltaManifest::patchPrefix().size());
+            m_fileMode = mode;
+            m_fileMtime = parseNumeric(header + 136, 12);
+            if (!startInMemoryEntry(size, QString("Запись '%1' дельта-пакета").arg(targetPath))) {
+                return false;
+            }
+            break;
+        }
+        if (!ensureParentDirectory(targetPath)) {
+            return false;
+        }
+        m_entryKind = EntryKind::File;
+        m_filePath = targetPath;
+        m_fileSize = size;
+        m_fileMode = mode;
+        m_fileMtime = parseNumeric(header + 136, 12);
+        m_entryDigest = m_uncheckedEntries.take(targetPath);
+        m_entryHash.reset();
+        m_fileBaseline = findBaseline(targetPath, size, mode, m_fileMtime);
+        // Мелкие файлы копим в буфере пачки и отдаём пулу записи, крупные пишем потоково
+        m_fileBuffered = m_writerThreadsEnabled && size <= kMaxBufferedFileSize;
+        // Крупный файл, совпавший с индексом, только хэшируется; решение - в конце записи
+        m_fileReused = !m_fileBuffered && m_fileBaseline;
+        if (m_fileBuffered) {
+            reserveBatchSpace(targetPath, size);
+        } else if (!m_fileReused && !openRegularFile(targetPath, size)) {
+            return false;
+        }
+        break;
+    case '5':
+        if (!createDirectory(targetPath, mode)) {
+            return false;
+        }
+        entryDone();
+        break;
+    case '2':
+        if (!ensureParentDirectory(targetPath) || !createSymlink(linkTarget, targetPath)) {
+            return false;
+        }
+        entryDone();
+        break;
+    case '1': {
+        const QString existing = resolveTargetPath(linkTarget);
+        if (existing.isNull()) {
+            return fail(QString("Архив содержит недопустимую жёсткую ссылку: '%1'").arg(linkTarget));
+        }
+        // Файл, на который ссылаемся, мог ещё не дойти до диска
+        drainWriters();
+        if (!ensureParentDirectory(targetPath) || !createHardlink(existing, targetPath)) {
+            return false;
+        }
+        // Ссылка - такой же файл установки: без неё в индексе дельта-обновление её потеряет.
+        // Цель, записанная до контрольной точки, попадёт в индекс при его дополнении по дереву
+        if (const InstalledFile* linked = m_installedIndex.find(existing)) {
+            const InstalledFile file = *linked;
+            recordInstalled(targetPath, file.size, file.mode, file.mtime, file.sha256, FileSource::Written);
+        }
+        entryDone();
+        break;
+    }
+    default:
+        // Устройства, FIFO и прочее в пакетах с исходниками не нужны - пропускаем
+        break;
+    }
+
+    return size > 0 || finishEntry();
+}
+
+bool ArchiveExtractor::consumeEntryData(const char* data, qint64 size) {
+    switch (m_entryKind) {
+    case EntryKind::File: {
+        // Буферизованные файлы хэшируются в пуле записи, здесь - только для проверки по манифесту
+        if (!m_fileBuffered || !m_entryDigest.isEmpty()) {
+            m_entryHash.addData(data, static_cast<int>(size));
+        }
+        if (m_fileBuffered) {
+            // m_entryRemaining ещё не уменьшен на эту порцию
+            std::memcpy(m_batchBuffer + m_batchUsed + (m_fileSize - m_entryRemaining), data, static_cast<size_t>(size));
+            return true;
+        }
+        if (m_fileReused) {
+            return true;
+        }
+        PhaseTimer writeTimer(m_counters->writeNs);
+        PACKMAN_TRACE_SCOPE("write.stream", size);
+        QString error;
+        return m_file.write(data, size, &error) || fail(error);
+    }
+    case EntryKind::LongName:
+    case EntryKind::LongLink:
+    case EntryKind::PaxHeader:
+    case EntryKind::Delta:
+    case EntryKind::Patch:
+        m_extData.append(data, static_cast<int>(size));
+        return true;
+    default:
+        return true;
+    }
+}
+
+// Записи, данные которых нужны целиком, копятся в m_extData - в пределах четверти бюджета памяти
+bool ArchiveExtractor::startInMemoryEntry(qint64 size, const QString& what) {
+    const qint64 limit = qMin<qint64>(m_memoryBudget / 4, std::numeric_limits<int>::max());
+    m_extData.clear();
+    if (size < 0 || size > limit) {
+        m_extData.squeeze();
+        return fail(QString("%1 слишком велика: %2 байт при допустимых %3").arg(what).arg(size).arg(limit));
+    }
+    m_extData.reserve(static_cast<int>(size));
+    return true;
+}
+
+bool ArchiveExtractor::finishEntry() {
+    switch (m_entryKind) {
+    case EntryKind::File:
+        // Файл с неверной суммой не попадает на диск (буферизованный) или будет удалён вместе с промежуточной папкой
+        if (!m_entryDigest.isEmpty()) {
+            if (m_entryHash.result() != m_entryDigest) {
+                return fail(QString("Контрольная сумма файла '%1' не совпадает с манифестом").arg(m_filePath));
+            }
+            m_verifiedEntries.append(m_filePath);
+        }
+        if (m_fileBuffered) {
+            BufferedFile file;
+            file.path = m_filePath;
+            file.offset = m_batchUsed;
+            file.size = m_fileSize;
+            file.mode = m_fileMode;
+            file.mtime = m_fileMtime;
+            file.knownHash = m_entryDigest.isEmpty() ? QByteArray() : m_entryHash.result();
+            file.baseline = m_fileBaseline;
+            m_batchFiles.append(file);
+            m_batchPaths.insert(m_filePath);
+            m_batchUsed += m_fileSize;
+            m_batchCost += qMax(m_fileSize, kMinFileCost);
+            if (m_batchCost >= m_batchPool->bufferSize()) {
+                flushBatch();
+            }
+        } else {
+            PhaseTimer writeTimer(m_counters->writeNs);
+            PACKMAN_TRACE_SCOPE("write.close", m_fileSize);
+            const QByteArray hash = m_entryHash.result();
+            QString error;
+            if (m_fileReused) {
+                if (hash != m_fileBaseline->sha256 ||
+                    !m_tree.linkExternal(m_baselineDir + '/' + m_filePath, m_filePath, &error)) {
+                    m_needsFullExtraction = true;
+                    return fail(QString("Файл '%1' изменился при тех же размере и времени - нужна полная распаковка").arg(m_filePath));
+                }
+            } else if (!m_file.close(m_fileMode, m_fileMtime, &error)) {
+                return fail(error);
+            }
+            // Уже записанный крупный файл заменяется ссылкой на объект хранилища, если он там есть
+            qint64 mtime = m_fileMtime;
+            const FileSource source = m_fileReused ? FileSource::Reused : storeFile(m_filePath, hash, m_fileMode, m_fileMtime, &mtime);
+            recordInstalled(m_filePath, m_fileSize, m_fileMode, mtime, hash, source);
+        }
+        entryDone();
+        break;
+    case EntryKind::LongName:
+        m_pendingPath = QString::fromUtf8(m_extData.constData(), static_cast<int>(qstrnlen(m_extData.constData(), static_cast<uint>(m_extData.size()))));
+        break;
+    case EntryKind::LongLink:
+        m_pendingLink = QString::fromUtf8(m_extData.constData(), static_cast<int>(qstrnlen(m_extData.constData(), static_cast<uint>(m_extData.size()))));
+        break;
+    case EntryKind::PaxHeader:
+        applyPaxRecords(m_extData);
+        break;
+    case EntryKind::Delta: {
+        QString error;
+        if (!DeltaManifest::parse(m_extData, &m_delta, &error)) {
+            return fail(error);
+        }
+        m_deltaLoaded = true;
+        break;
+    }
+    case EntryKind::Patch:
+        if (!applyPatch()) {
+            return false;
+        }
+        // Буфер патча не держится до следующей служебной записи
+        m_extData = QByteArray();
+        entryDone();
+        break;
+    default:
+        break;
+    }
+    m_entryKind = EntryKind::None;
+    return true;
+}
+
+void ArchiveExtractor::applyPaxRecords(const QByteArray& records) {
+    TarFormat::parsePaxRecords(records, &m_pendingPath, &m_pendingLink);
+}
+
+QString ArchiveExtractor::resolveTargetPath(const QString& entryPath) const {
+    const QString cleaned = QDir::cleanPath(entryPath);
+    if (cleaned.isEmpty() || QDir::isAbsolutePath(cleaned) || cleaned == ".." || cleaned.startsWith("../")) {
+        return QString();
+    }
+    // Путь относительно корня установки; "" - сам корень
+    return cleaned == "." ? QString("") : cleaned;
+}
+
+bool ArchiveExtractor::createDirectory(const QString& path, int mode) {
+    QString error;
+    if (!m_tree.makeDirectory(path, &error)) {
+        return fail(error);
+    }
+    m_directoryModes.append(qMakePair(path, mode));
+    return true;
+}
+
+bool ArchiveExtractor::ensureParentDirectory(const QString& filePath) {
+    const int slash = filePath.lastIndexOf('/');
+    if (slash < 0) {
+        return true;
+    }
+    // Открытые каталоги кэшируются в OutputTree, повторный вызов не доходит до системы
+    QString error;
+    return m_tree.makeDirectory(filePath.left(slash), &error) || fail(error);
+}
+
+bool ArchiveExtractor::openRegularFile(const QString& path, qint64 size) {
+    // Пока пишется крупный файл, пул записи занят накопленной пачкой
+    flushBatch();
+    waitForPath(path);
+    QString error;
+    return m_file.open(&m_tree, path, size, &error) || fail(error);
+}
+
+void ArchiveExtractor::reserveBatchSpace(const QString& path, qint64 size) {
+    // Повторная запись того же пути из другой пачки ждёт завершения предыдущей;
+    // внутри одной пачки файлы пишутся по порядку
+    if (!m_batchPaths.contains(path)) {
+        waitForPath(path);
+    }
+    if (m_batchBuffer && m_batchUsed + size > m_batchPool->bufferSize()) {
+        flushBatch();
+    }
+    if (!m_batchBuffer) {
+        // Все буферы в очереди записи: разбор ждёт, пока пул записи не догонит
+        PACKMAN_TRACE_SCOPE("writers.backpressure");
+        m_batchBuffer = m_batchPool->acquire();
+        m_batchUsed = 0;
+        m_batchCost = 0;
+    }
+}
+
+void ArchiveExtractor::flushBatch() {
+    if (m_batchFiles.isEmpty()) {
+        return;
+    }
+    {
+        QMutexLocker lock(&m_writerMutex);
+        m_inFlightPaths.unite(m_batchPaths);
+    }
+    InstallCounters* counters = m_counters;
+    BufferPool* pool = m_batchPool.get();
+    char* buffer = m_batchBuffer;
+    const QVector<BufferedFile> files = m_batchFiles;
+    m_batchBuffer = nullptr;
+    m_batchFiles.clear();
+    m_batchPaths.clear();
+
+    m_writerPool.start(new FunctionRunnable([this, counters, pool, buffer, files]() {
+        QString error;
+        for (const BufferedFile& file : files) {
+            const QString fileError = installFile(counters, file.path, buffer + file.offset, file.size, file.mode,
+                                                  file.mtime, file.knownHash, file.baseline);
+            if (error.isEmpty()) {
+                error = fileError;
+            }
+        }
+        pool->release(buffer);
+
+        QMutexLocker lock(&m_writerMutex);
+        for (const BufferedFile& file : files) {
+            m_inFlightPaths.remove(file.path);
+        }
+        if (!error.isEmpty() && m_writerError.isEmpty()) {
+            m_writerError = error;
+        }
+        m_writerProgress.wakeAll();
+    }));
+}
+
+void ArchiveExtractor::submitFile(const QString& path, const QByteArray& data, int mode, qint64 mtime,
+                                  const QByteArray& knownHash, const InstalledFile* baseline) {
+    const qint64 cost = qMax<qint64>(data.size(), kMinFileCost);
+    if (m_batchPaths.contains(path)) {
+        flushBatch();
+    }
+    {
+        QMutexLocker lock(&m_writerMutex);
+        // Ограничиваем объём данных в очереди: разбор ждёт, пока пул записи не догонит.
+        // Повторная запись того же пути ждёт завершения предыдущей
+        while ((m_inFlightBytes > m_memoryBudget / 4 || m_inFlightPaths.contains(path)) && m_writerError.isEmpty()) {
+            PACKMAN_TRACE_SCOPE("writers.backpressure");
+            m_writerProgress.wait(&m_writerMutex);
+        }
+        m_inFlightBytes += cost;
+        m_inFlightPaths.insert(path);
+    }
+
+    InstallCounters* counters = m_counters;
+    m_writerPool.start(new FunctionRunnable([this, counters, path, data, mode, mtime, cost, knownHash, baseline]() {
+        const QString error = installFile(counters, path, data.constData(), data.size(), mode, mtime, knownHash, baseline);
+
+        QMutexLocker lock(&m_writerMutex);
+        m_inFlightBytes -= cost;
+        m_inFlightPaths.remove(path);
+        if (!error.isEmpty() && m_writerError.isEmpty()) {
+            m_writerError = error;
+        }
+        m_writerProgress.wakeAll();
+    }));
+}
+
+QString ArchiveExtractor::installFile(InstallCounters* counters, const QString& path, const char* data, qint64 size, int mode,
+                                      qint64 mtime, const QByteArray& knownHash, const InstalledFile* baseline) {
+    QString error;
+    QByteArray hash;
+    FileSource source = FileSource::Written;
+    qint64 installedMtime = mtime;
+    {
+        PhaseTimer writeTimer(counters->writeNs);
+        PACKMAN_TRACE_SCOPE("write.file", size);
+        // Хэш для индекса считается здесь, параллельно разбору
+        if (knownHash.isEmpty()) {
+            QCryptographicHash hasher(QCryptographicHash::Sha256);
+            hasher.addData(data, static_cast<int>(size));
+            hash = hasher.result();
+        } else {
+            hash = knownHash;
+        }
+        QString linkError;
+        if (baseline && hash == baseline->sha256 && m_tree.linkExternal(m_baselineDir + '/' + path, path, &linkError)) {
+            source = FileSource::Reused;
+        } else if (m_store && m_store->materialize(hash, mode, mtime, m_tree.absolutePath(path), &installedMtime)) {
+            source = FileSource::Stored;
+        } else if (m_tree.writeFile(path, data, size, mode, mtime, &error) && m_store) {
+            m_store->ingest(m_tree.absolutePath(path), hash, mode);
+        }
+    }
+    if (error.isEmpty()) {
+        recordInstalled(path, size, mode, installedMtime, hash, source);
+    }
+    return error;
+}
+
+bool ArchiveExtractor::applyPatch() {
+    const QString& path = m_filePath;
+    if (!m_deltaLoaded) {
+        return fail(QString("Патч '%1' встретился раньше манифеста дельта-пакета").arg(path));
+    }
+    const auto sums = m_delta.patches.constFind(path);
+    if (sums == m_delta.patches.constEnd()) {
+        return fail(QString("Патч '%1' не описан в манифесте дельта-пакета").arg(path));
+    }
+    // Патч применим только к той версии файла, для которой он собран
+    const QString basePath = m_deltaBaseDir + '/' + path;
+    const InstalledFile* base = m_deltaBaseIndex->find(path);
+    if (!base || base->sha256 != sums.value().baseSha256 || !matchesOnDisk(basePath, *base)) {
+        return fail(QString("Файл '%1' базовой версии отличается от ожидаемого - нужна полная установка").arg(path));
+    }
+
+    PhaseTimer writeTimer(m_counters->writeNs);
+    PACKMAN_TRACE_SCOPE("delta.patch", m_extData.size());
+    QFile baseFile(basePath);
+    if (!baseFile.open(QIODevice::ReadOnly)) {
+        return fail(QString("Не удалось открыть '%1': %2").arg(basePath, baseFile.errorString()));
+    }
+    const uchar* baseData = baseFile.size() > 0 ? baseFile.map(0, baseFile.size()) : nullptr;
+    if (baseFile.size() > 0 && !baseData) {
+        return fail(QString("Не удалось прочитать '%1': %2").arg(basePath, baseFile.errorString()));
+    }
+    QByteArray result;
+    QString error;
+    if (!BinaryPatch::apply(reinterpret_cast<const char*>(baseData), baseData ? baseFile.size() : 0, m_extData, &result, &error,
+                            m_memoryBudget / 4)) {
+        return fail(QString("Патч '%1' не применяется: %2").arg(path, error));
+    }
+    if (QCryptographicHash::hash(result, QCryptographicHash::Sha256) != sums.value().targetSha256) {
+        return fail(QString("Контрольная сумма '%1' после патча не совпадает").arg(path));
+    }
+    if (!ensureParentDirectory(path)) {
+        return false;
+    }
+    submitFile(path, result, m_fileMode, m_fileMtime, sums.value().targetSha256, nullptr);
+    return true;
+}
+
+bool ArchiveExtractor::linkDeltaBase() {
+    if (!m_deltaBaseIndex) {
+        return true;
+    }
+    if (!m_deltaLoaded) {
+        return fail("В дельта-пакете нет манифеста");
+    }
+    PACKMAN_TRACE_SCOPE("delta.link", m_deltaBaseIndex->size());
+    // Всё, что не удалено и не пришло в архиве, не изменилось - берём из базовой версии.
+    // Набор файлов берётся из самого дерева базовой версии, а не из её индекса: дельта собрана
+    // по дереву, и файл, которого нет в индексе, иначе пропал бы вместе с удалённой базовой версией
+    const QDir baseDir(m_deltaBaseDir);
+    const QDir::Filters filters = QDir::Files | QDir::Hidden | QDir::System | QDir::NoSymLinks;
+    QSet<QString> carried;
+    for (QDirIterator it(m_deltaBaseDir, filters, QDirIterator::Subdirectories); it.hasNext();) {
+        const QString basePath = it.next();
+        const QString path = baseDir.relativeFilePath(basePath);
+        if (m_delta.removed.contains(path) || m_delta.patches.contains(path) || m_installedIndex.find(path)) {
+            continue;
+        }
+        // Индекс базовой версии полный (см. InstalledIndex::addMissingFiles): файл не из индекса
+        // появился после установки, и дельта могла быть собрана без учёта его содержимого
+        const InstalledFile* file = m_deltaBaseIndex->find(path);
+        if (!file) {
+            return fail(QString("Файл '%1' базовой версии не описан в её индексе - нужна полная установка").arg(path));
+        }
+        if (!matchesOnDisk(basePath, *file)) {
+            return fail(QString("Файл '%1' базовой версии изменён после установки - нужна полная установка").arg(path));
+        }
+        if (!ensureParentDirectory(path)) {
+            return false;
+        }
+        QString error;
+        if (!m_tree.linkExternal(basePath, path, &error)) {
+            return fail(error);
+        }
+        const QByteArray expected = m_uncheckedEntries.take(path);
+        if (!expected.isEmpty() && expected != file->sha256) {
+            return fail(QString("Контрольная сумма файла '%1' не совпадает с манифестом").arg(path));
+        }
+        recordInstalled(path, file->size, file->mode, file->mtime, file->sha256, FileSource::Reused);
+        carried.insert(path);
+    }
+    // Файл из индекса, которого нет на диске, - базовая версия повреждена
+    const QHash<QString, InstalledFile>& files = m_deltaBaseIndex->files();
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        const QString& path = it.key();
+        if (!carried.contains(path) && !m_delta.removed.contains(path) && !m_delta.patches.contains(path) &&
+            !m_installedIndex.find(path)) {
+            return fail(QString("Файл '%1' базовой версии отсутствует - нужна полная установка").arg(path));
+        }
+    }
+    return true;
+}
+
+const InstalledFile* ArchiveExtractor::findBaseline(const QString& path, qint64 size, int mode, qint64 mtime) const {
+    if (!m_baselineIndex) {
+        return nullptr;
+    }
+    const InstalledFile* file = m_baselineIndex->find(path);
+    if (!file || file->size != size || file->mode != mode || file->mtime != mtime) {
+        return nullptr;
+    }
+    // Файл на диске не должен был измениться с момента установки
+    return matchesOnDisk(m_baselineDir + '/' + path, *file) ? file : nullptr;
+}
+
+ArchiveExtractor::FileSource ArchiveExtractor::storeFile(const QString& path, const QByteArray& hash, int mode, qint64 mtime, qint64* actualMtime) {
+    if (!m_store) {
+        return FileSource::Written;
+    }
+    const QString absolutePath = m_tree.absolutePath(path);
+    if (m_store->materialize(hash, mode, mtime, absolutePath, actualMtime)) {
+        return FileSource::Stored;
+    }
+    // Ошибка добавления не мешает установке - файл просто не будет разделяться
+    m_store->ingest(absolutePath, hash, mode);
+    return FileSource::Written;
+}
+
+void ArchiveExtractor::recordInstalled(const QString& path, qint64 size, int mode, qint64 mtime, const QByteArray& hash, FileSource source) {
+    InstalledFile file;
+    file.size = size;
+    file.mtime = mtime;
+    file.mode = mode;
+    file.sha256 = hash;
+    QMutexLocker lock(&m_writerMutex);
+    m_installedIndex.insert(path, file);
+    if (source == FileSource::Reused) {
+        ++m_entriesReused;
+    } else if (source == FileSource::Stored) {
+        ++m_entriesFromStore;
+    }
+}
+
+void ArchiveExtractor::waitForPath(const QString& path) {
+    if (m_batchPaths.contains(path)) {
+        flushBatch();
+    }
+    QMutexLocker lock(&m_writerMutex);
+    while (m_inFlightPaths.contains(path)) {
+        m_writerProgress.wait(&m_writerMutex);
+    }
+}
+
+void ArchiveExtractor::drainWriters() {
+    PACKMAN_TRACE_SCOPE("writers.drain");
+    flushBatch();
+    m_writerPool.waitForDone();
+}
+
+bool ArchiveExtractor::checkWriters() {
+    QMutexLocker lock(&m_writerMutex);
+    if (m_writerError.isEmpty()) {
+        return true;
+    }
+    const QString error = m_writerError;
+    lock.unlock();
+    return fail(error);
+}
+
+bool ArchiveExtractor::createSymlink(const QString& target, const QString& path) {
+    waitForPath(path);
+    QString error;
+    return m_tree.createSymlink(path, target, &error) || fail(error);
+}
+
+bool ArchiveExtractor::createHardlink(const QString& target, const QString& path) {
+    QString error;
+    return m_tree.createHardlink(path, target, &error) || fail(error);
+}
+
+void ArchiveExtractor::applyDirectoryPermissions() {
+    PACKMAN_TRACE_SCOPE("directory.permissions", m_directoryModes.size());
+    // В обратном порядке: вложенные каталоги раньше родительских
+    for (int i = m_directoryModes.size() - 1; i >= 0; --i) {
+        m_tree.setDirectoryMode(m_directoryModes.at(i).first, m_directoryModes.at(i).second);
+    }
+}
+
+bool ArchiveExtractor::verifyDigests() {
+    if (!m_expectedArchiveDigest.isEmpty() && m_archiveDigest != m_expectedArchiveDigest) {
+        return fail(QString("Контрольная сумма архива не совпадает с манифестом (получено %1)")
+                        .arg(QString::fromLatin1(m_archiveDigest.toHex())));
+    }
+    if (!m_uncheckedEntries.isEmpty()) {
+        return fail(QString("В архиве нет файла '%1', указанного в манифесте").arg(m_uncheckedEntries.constBegin().key()));
+    }
+    return true;
+}
+
+void ArchiveExtractor::entryDone() {
+    ++m_entriesWritten;
+    m_counters->addEntry();
+}
+
+bool ArchiveExtractor::fail(const QString& message) {
+    if (m_error.isEmpty()) {
+        m_error = message;
+    }
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QStringList>
+#include <QPair>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QVector>
+
+#include "ArchiveIndex.h"
+#include "BufferPool.h"
+#include "ContentStore.h"
+#include "DeltaPackage.h"
+#include "ExtractionJournal.h"
+#include "InstallProgress.h"
+#include "InstalledIndex.h"
+#include "OutputTree.h"
+#include "PackageInfo.h"
+
+#include <atomic>
+#include <memory>
+
+class QIODevice;
+class StreamDecoder;
+
+// Потоковый распаковщик tar-архивов (gzip, zstd, xz или без сжатия).
+// Читает сжатые байты напрямую из ресурса Qt (QResource::data()) или из
+// отображённого в память файла, распаковывает их подключаемым декодером
+// (StreamDecoder) и сразу пишет
+// записи tar в целевую папку - за один проход, без временной копии архива
+// и без внешнего процесса tar.
+//
+// Работа конвейерная: блочный gzip (BGZF) разжимается параллельно, а мелкие файлы
+// пачками передаются пулу потоков записи, пока разбор архива идёт дальше.
+// Все промежуточные буферы берутся из пулов фиксированного размера (см. setMemoryBudget()):
+// память не зависит от размера архива, а разбор ждёт, пока запись не освободит буфер.
+// Файловые операции идут через OutputTree - относительно открытых дескрипторов каталогов.
+class ArchiveExtractor {
+public:
+    explicit ArchiveExtractor(const QString& targetDir);
+    ~ArchiveExtractor();
+
+    ArchiveExtractor(const ArchiveExtractor&) = delete;
+    ArchiveExtractor& operator=(const ArchiveExtractor&) = delete;
+
+    // Распаковывает архив (путь ресурса ":/..." или обычный файл).
+    // При ошибке возвращает false, текст ошибки доступен через errorString()
+    bool extract(const QString& archivePath);
+
+    // Распаковывает только выбранные записи (ArchiveIndex::select()) архива с индексом BGZF.
+    // Каждая непрерывная группа записей разжимается с ближайшего блока, остальной архив
+    // не читается. Сумма архива при этом не проверяется: вместо неё CRC каждого затронутого
+    // блока (включая последний, дочитываемый до конца) и суммы выбранных файлов. Целевая
+    // папка должна быть промежуточной - на место файлы переносит вызывающий
+    bool extractEntries(const QString& archivePath, const ArchiveIndex& index, const QList<ArchiveEntry>& entries);
+
+    // Формат архива; по умолчанию определяется по сигнатуре
+    void setFormat(ArchiveFormat format) { m_format = format; }
+
+    // Число потоков распаковки (только для BGZF) и потоков записи файлов.
+    // 0 потоков записи - все файлы пишутся в потоке разбора
+    void setThreadCounts(int decoderThreads, int writerThreads);
+
+    // Сколько памяти может занимать конвейер распаковки: распакованные блоки BGZF, мелкие
+    // файлы и результаты патчей, ожидающие записи. Служебные записи и патчи, которые читаются
+    // в память целиком, больше четверти бюджета - ошибка распаковки. Вызывается до extract()
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const { return m_memoryBudget; }
+
+    // Ожидаемые SHA-256 архива и отдельных файлов (ключ - путь в архиве после QDir::cleanPath).
+    // Суммы считаются на тех же буферах, что идут в распаковку, без повторного чтения архива.
+    // Несовпадение - ошибка распаковки; записанное к этому моменту нужно считать недостоверным
+    void setExpectedDigests(const QByteArray& archiveSha256, const QHash<QString, QByteArray>& entrySha256);
+
+    // Журнал контрольных точек: распаковка периодически сохраняет в него позицию, до которой
+    // всё записано. Валидная resumeFrom того же архива - продолжение прерванной распаковки
+    // в ту же папку: записи до контрольной точки пропускаются без записи на диск.
+    // Точка другого архива (путь, размер или отпечаток не совпали) не применяется
+    void setJournal(ExtractionJournal* journal, const ExtractionCheckpoint& resumeFrom = ExtractionCheckpoint());
+    // Продолжена ли распаковка с контрольной точки
+    bool isResumed() const { return m_resumeOffset > 0; }
+
+    // Прежняя установка пакета для инкрементальной переустановки. Файл, у которого размер,
+    // время и права совпадают с индексом и в архиве, и на диске, а SHA-256 содержимого - с индексом,
+    // не записывается, а связывается жёсткой ссылкой из baseDir
+    void setBaseline(const QString& baseDir, const InstalledIndex* index);
+    // Индекс файлов, записанных (или взятых из прежней установки) этой распаковкой.
+    // После продолжения с контрольной точки в нём нет файлов, записанных до неё
+    const InstalledIndex& installedIndex() const { return m_installedIndex; }
+    qint64 entriesReused() const { return m_entriesReused; }
+    // Крупный файл совпал с индексом по размеру и времени, но не по содержимому, а его
+    // данные уже не записаны - нужна распаковка без setBaseline()
+    bool needsFullExtraction() const { return m_needsFullExtraction; }
+
+    // Установленная базовая версия для дельта-пакета (см. DeltaManifest): патчи применяются
+    // к её файлам, а неизменившиеся файлы связываются из baseDir жёсткими ссылками.
+    // Базовые файлы проверяются по индексу: изменённые после установки - ошибка
+    void setDeltaBase(const QString& baseDir, const InstalledIndex* index);
+
+    // Хранилище содержимого: файл, который уже есть в хранилище, не записывается, а связывается
+    // с объектом; новые файлы после записи добавляются в хранилище
+    void setContentStore(const ContentStore* store) { m_store = store; }
+    qint64 entriesFromStore() const { return m_entriesFromStore; }
+
+    // Внешние счётчики прогресса. Через них же приходит запрос отмены (cancelRequested) (обновляются из потока распаковки). По умолчанию - внутренние
+    void setCounters(InstallCounters* counters) { m_counters = counters ? counters : &m_ownCounters; }
+
+    QString errorString() const { return m_error; }
+    qint64 entriesWritten() const { return m_entriesWritten; }
+
+private:
+    // Тип текущей записи tar и куда направлять её данные
+    enum class EntryKind { None, File, LongName, LongLink, PaxHeader, Delta, Patch, Skip };
+    // Откуда взялся установленный файл
+    enum class FileSource { Written, Reused, Stored };
+    // Мелкий файл в пачке, ожидающей записи; данные - в буфере пачки со смещения offset
+    struct BufferedFile {
+        QString path;
+        qint64 offset = 0;
+        qint64 size = 0;
+        int mode = 0;
+        qint64 mtime = 0;
+        QByteArray knownHash;
+        const InstalledFile* baseline = nullptr;
+    };
+
+    void applyCheckpoint(const QString& archivePath, qint64 archiveSize);
+    void restartFromBeginning();
+    bool writeCheckpoint(qint64 headerOffset);
+    bool isCancelled();
+    // ownMapping - data получены собственным QFile::map(), и прочитанные страницы можно отпускать
+    bool extractMapped(const uchar* data, qint64 size, bool ownMapping);
+    bool extractFromMemory(const uchar* data, qint64 size);
+    bool extractFromDevice(QIODevice* device);
+    bool extractRange(const uchar* data, qint64 size, const ArchiveIndex::Block& block, qint64 begin, qint64 end);
+    bool decodeInput(const uchar* data, qint64 size);
+    void releaseInput(const uchar* data, qint64 consumed);
+    bool finishInput();
+
+    bool consumeTar(const char* data, qint64 size);
+    bool handleHeader(const char* header);
+    bool consumeEntryData(const char* data, qint64 size);
+    bool finishEntry();
+    bool startInMemoryEntry(qint64 size, const QString& what);
+    void applyPaxRecords(const QByteArray& records);
+
+    bool createDirectory(const QString& path, int mode);
+    bool ensureParentDirectory(const QString& filePath);
+    bool openRegularFile(const QString& path, qint64 size);
+    void reserveBatchSpace(const QString& path, qint64 size);
+    void flushBatch();
+    void submitFile(const QString& path, const QByteArray& data, int mode, qint64 mtime,
+                    const QByteArray& knownHash, const InstalledFile* baseline);
+    QString installFile(InstallCounters* counters, const QString& path, const char* data, qint64 size, int mode,
+                        qint64 mtime, const QByteArray& knownHash, const InstalledFile* baseline);
+    const InstalledFile* findBaseline(const QString& path, qint64 size, int mode, qint64 mtime) const;
+    bool applyPatch();
+    bool linkDeltaBase();
+    FileSource storeFile(const QString& path, const QByteArray& hash, int mode, qint64 mtime, qint64* actualMtime);
+    void recordInstalled(const QString& path, qint64 size, int mode, qint64 mtime, const QByteArray& hash, FileSource source);
+    void waitForPath(const QString& path);
+    void drainWriters();
+    bool checkWriters();
+    bool createSymlink(const QString& target, const QString& path);
+    bool createHardlink(const QString& target, const QString& path);
+    QString resolveTargetPath(const QString& entryPath) const;
+    void applyDirectoryPermissions();
+    bool verifyDigests();
+
+    void entryDone();
+    bool fail(const QString& message);
+
+    OutputTree m_tree;
+    QString m_error;
+    qint64 m_entriesWritten = 0;
+    InstallCounters m_ownCounters;
+    InstallCounters* m_counters = &m_ownCounters;
+
+    // Состояние декодера
+    ArchiveFormat m_format = ArchiveFormat::Auto;
+    ArchiveFormat m_detectedFormat = ArchiveFormat::Auto;
+    std::unique_ptr<StreamDecoder> m_decoder;
+    bool m_memberEnded = false;
+    QByteArray m_outBuffer;
+
+    // Состояние разбора tar
+    char m_header[512];
+    int m_headerFill = 0;
+    qint64 m_entryRemaining = 0;
+    qint64 m_entryPadding = 0;
+    bool m_tarFinished = false;
+    EntryKind m_entryKind = EntryKind::None;
+    QByteArray m_extData;       // Данные служебных записей (GNU longname, pax, манифест и патчи дельты), не больше четверти бюджета
+    QString m_pendingPath;      // Имя из GNU longname / pax для следующей записи
+    QString m_pendingLink;      // Цель ссылки из GNU longlink / pax
+
+    // Текущий файл: либо пишется потоково (m_file), либо копится в буфере пачки для пула записи.
+    // Пути записей - относительные, от корня m_tree
+    OutputTree::FileWriter m_file;
+    QString m_filePath;
+    qint64 m_fileSize = 0;
+    bool m_fileBuffered = false;
+    int m_fileMode = 0;
+    qint64 m_fileMtime = 0;
+
+    // Проверка целостности
+    QByteArray m_expectedArchiveDigest;
+    QHash<QString, QByteArray> m_expectedEntryDigests;
+    QHash<QString, QByteArray> m_uncheckedEntries;  // Файлы из манифеста, ещё не встреченные в архиве
+    QByteArray m_archiveDigest;
+    QCryptographicHash m_archiveHash{QCryptographicHash::Sha256};
+    QCryptographicHash m_entryHash{QCryptographicHash::Sha256};
+    QByteArray m_entryDigest;                       // Ожидаемая сумма текущего файла; пусто - не проверяется
+    QThreadPool m_verifyPool;
+    QStringList m_verifiedEntries;                  // Файлы, сумма которых уже сошлась
+
+    // Инкрементальная переустановка
+    QString m_baselineDir;
+    const InstalledIndex* m_baselineIndex = nullptr;
+    const InstalledFile* m_fileBaseline = nullptr; // Совпавший с индексом текущий файл
+    bool m_fileReused = false;                      // Текущий крупный файл не пишется, а берётся из прежней установки
+    InstalledIndex m_installedIndex;                // Пополняется и из пула записи - под m_writerMutex
+    qint64 m_entriesReused = 0;
+    bool m_needsFullExtraction = false;
+
+    // Дельта-пакет
+    QString m_deltaBaseDir;
+    const InstalledIndex* m_deltaBaseIndex = nullptr;
+    DeltaManifest m_delta;
+    bool m_deltaLoaded = false;
+
+    // Хранилище содержимого
+    const ContentStore* m_store = nullptr;
+    qint64 m_entriesFromStore = 0;
+
+    // Контрольные точки
+    ExtractionJournal* m_journal = nullptr;
+    ExtractionCheckpoint m_resume;
+    QString m_archivePath;
+    qint64 m_archiveSize = 0;
+    QByteArray m_archiveFingerprint;
+    qint64 m_inputOffset = 0;      // Сжатых байт передано декодеру, от начала архива
+    qint64 m_tarOffset = 0;        // Разобрано байт tar
+    qint64 m_restartInput = 0;     // Последнее начало члена сжатого потока...
+    qint64 m_restartOutput = 0;    // ...и соответствующее ему смещение в tar
+    qint64 m_resumeOffset = 0;     // Записи до этого смещения уже на диске
+    qint64 m_lastCheckpoint = 0;
+
+    // Отображённый архив: прочитанные страницы отпускаются, когда их разобрали и захэшировали
+    std::atomic<qint64> m_inputHashed{0};
+    qint64 m_inputReleased = 0;
+    bool m_releaseInput = false;    // Только для собственного отображения файла, не для памяти ресурса
+
+    int m_decoderThreads;
+    bool m_writerThreadsEnabled = true;
+    QThreadPool m_writerPool;
+    QMutex m_writerMutex;
+    QWaitCondition m_writerProgress;
+    qint64 m_inFlightBytes = 0;         // Объём результатов патчей, ожидающих записи в пуле
+    QSet<QString> m_inFlightPaths;      // Файлы, которые сейчас пишутся
+    QString m_writerError;
+
+    // Бюджет памяти и пачки мелких файлов
+    qint64 m_memoryBudget = 0;
+    std::unique_ptr<BufferPool> m_batchPool;
+    char* m_batchBuffer = nullptr;      // Буфер открытой пачки; nullptr - ещё не взят из пула
+    qint64 m_batchUsed = 0;
+    qint64 m_batchCost = 0;
+    QVector<BufferedFile> m_batchFiles;
+    QSet<QString> m_batchPaths;
+
+    // Права каталогов применяются в конце, иначе read-only каталог не даст создать в нём файлы
+    QList<QPair<QString, int>> m_directoryModes;
+};
\ No newline at end of file
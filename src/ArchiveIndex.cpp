@@ -0,0 +1,400 @@
+#include "ArchiveIndex.h"
+#include "ArchiveWriter.h"
+#include "StreamDecoder.h"
+#include "TarFormat.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace {
+
+constexpr quint32 kIndexMagic = 0x504b4958; // "PKIX"
+constexpr quint16 kIndexVersion = 1;
+constexpr int kReadChunk = 256 * 1024;
+
+// Разбор потока tar без записи на диск: только заголовки и смещения записей
+class TarScanner {
+public:
+    explicit TarScanner(QList<ArchiveEntry>* entries) : m_entries(entries) {}
+
+    bool feed(const char* data, qint64 size, QString* error) {
+        while (size > 0 && !m_finished) {
+            if (m_remaining > 0 || m_padding > 0) {
+                const qint64 take = qMin(size, m_remaining > 0 ? m_remaining : m_padding);
+                if (m_remaining > 0) {
+                    if (m_collecting) {
+                        m_extData.append(data, static_cast<int>(take));
+                    }
+                    m_remaining -= take;
+                    if (m_remaining == 0 && m_collecting) {
+                        finishExtension();
+                    }
+                } else {
+                    m_padding -= take;
+                }
+                m_offset += take;
+                data += take;
+                size -= take;
+                continue;
+            }
+
+            const int take = static_cast<int>(qMin<qint64>(size, TarFormat::kBlockSize - m_headerFill));
+            std::memcpy(m_header + m_headerFill, data, take);
+            m_headerFill += take;
+            m_offset += take;
+            data += take;
+            size -= take;
+            if (m_headerFill == TarFormat::kBlockSize) {
+                m_headerFill = 0;
+                if (!handleHeader(error)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    bool handleHeader(QString* error) {
+        if (TarFormat::isZeroBlock(m_header)) {
+            m_finished = true;
+            return true;
+        }
+        if (!TarFormat::verifyChecksum(m_header)) {
+            *error = "Архив повреждён: неверная контрольная сумма заголовка tar";
+            return false;
+        }
+        const qint64 headerOffset = m_offset - TarFormat::kBlockSize;
+        const char type = m_header[156];
+        const qint64 size = TarFormat::parseNumeric(m_header + 124, 12);
+        m_remaining = size;
+        m_padding = (TarFormat::kBlockSize - size % TarFormat::kBlockSize) % TarFormat::kBlockSize;
+        if (m_groupStart < 0) {
+            m_groupStart = headerOffset;
+        }
+
+        if (type == 'L' || type == 'K' || type == 'x') {
+            m_collecting = true;
+            m_extType = type;
+            m_extData.clear();
+            if (size == 0) {
+                finishExtension();
+            }
+            return true;
+        }
+        m_collecting = false;
+        if (type == 'g') {
+            m_groupStart = -1;
+            return true;
+        }
+
+        ArchiveEntry entry;
+        entry.path = QDir::cleanPath(m_pendingPath.isEmpty() ? TarFormat::headerPath(m_header) : m_pendingPath);
+        entry.type = type == '\0' || type == '7' ? '0' : type;
+        entry.size = size;
+        entry.mode = static_cast<int>(TarFormat::parseNumeric(m_header + 100, 8)) & 07777;
+        entry.mtime = TarFormat::parseNumeric(m_header + 136, 12);
+        entry.linkTarget = m_pendingLink.isEmpty() ? TarFormat::fieldString(m_header + 157, 100) : m_pendingLink;
+        entry.offset = m_groupStart;
+        entry.end = m_offset + size + m_padding;
+        m_entries->append(entry);
+
+        m_groupStart = -1;
+        m_pendingPath.clear();
+        m_pendingLink.clear();
+        return true;
+    }
+
+    void finishExtension() {
+        m_collecting = false;
+        const QString value = QString::fromUtf8(m_extData.constData(),
+                                                static_cast<int>(qstrnlen(m_extData.constData(), static_cast<uint>(m_extData.size()))));
+        if (m_extType == 'L') {
+            m_pendingPath = value;
+        } else if (m_extType == 'K') {
+            m_pendingLink = value;
+        } else {
+            TarFormat::parsePaxRecords(m_extData, &m_pendingPath, &m_pendingLink);
+        }
+    }
+
+    QList<ArchiveEntry>* m_entries;
+    char m_header[TarFormat::kBlockSize];
+    int m_headerFill = 0;
+    qint64 m_offset = 0;
+    qint64 m_remaining = 0;
+    qint64 m_padding = 0;
+    qint64 m_groupStart = -1;   // Первый служебный заголовок текущей записи
+    bool m_collecting = false;
+    char m_extType = 0;
+    QByteArray m_extData;
+    QString m_pendingPath;
+    QString m_pendingLink;
+    bool m_finished = false;
+};
+
+// Распаковывает архив целиком, передавая поток tar приёмнику
+bool decodeArchive(QIODevice* device, const std::function<bool(const char*, qint64)>& sink, QString* error) {
+    QByteArray input(kReadChunk, Qt::Uninitialized);
+    QByteArray output(kReadChunk, Qt::Uninitialized);
+    std::unique_ptr<StreamDecoder> decoder;
+    ArchiveFormat format = ArchiveFormat::Auto;
+    bool memberEnded = false;
+
+    for (;;) {
+        const qint64 bytesRead = device->read(input.data(), input.size());
+        if (bytesRead < 0) {
+            *error = QString("Ошибка чтения архива: %1").arg(device->errorString());
+            return false;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        const uchar* data = reinterpret_cast<const uchar*>(input.constData());
+        qint64 size = bytesRead;
+        if (!decoder) {
+            decoder = StreamDecoder::create(ArchiveFormat::Auto, data, size, error);
+            if (!decoder) {
+                return false;
+            }
+            format = StreamDecoder::detect(data, size);
+        }
+        // Полный выходной буфер - у декодера может остаться выход и без нового входа
+        bool outputFull = false;
+        while (size > 0 || outputFull) {
+            if (memberEnded) {
+                // Следующий член gzip / кадр zstd / поток xz; прочее - мусор в конце файла
+                if (size == 0) {
+                    break;
+                }
+                if (!decoder->startsMember(data, size) || !decoder->reset()) {
+                    return true;
+                }
+                memberEnded = false;
+            }
+            qint64 consumed = 0;
+            qint64 produced = 0;
+            const StreamDecoder::Status status = decoder->decode(data, size, &consumed, output.data(), output.size(), &produced);
+            if (status == StreamDecoder::Status::Error) {
+                *error = QString("Архив повреждён: %1").arg(decoder->errorString());
+                return false;
+            }
+            memberEnded = status == StreamDecoder::Status::StreamEnd;
+            outputFull = produced == output.size();
+            data += consumed;
+            size -= consumed;
+            if (produced > 0 && !sink(output.constData(), produced)) {
+                return false;
+            }
+            if (consumed == 0 && produced == 0) {
+                break;
+            }
+        }
+    }
+    if (!memberEnded && format != ArchiveFormat::Tar) {
+        *error = "Архив обрезан: сжатый поток завершился раньше времени";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+QString ArchiveIndex::pathFor(const QString& archivePath) {
+    return archivePath + ".pkidx";
+}
+
+bool ArchiveIndex::makeSeekable(const QString& inputPath, const QString& outputPath, ArchiveIndex* index, QString* error) {
+    QFile input(inputPath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        *error = QString("Не удалось открыть архив '%1': %2").arg(inputPath, input.errorString());
+        return false;
+    }
+    QSaveFile output(outputPath);
+    if (!output.open(QIODevice::WriteOnly)) {
+        *error = QString("Не удалось создать '%1': %2").arg(outputPath, output.errorString());
+        return false;
+    }
+
+    ArchiveIndex result;
+    TarScanner scanner(&result.m_entries);
+    BgzfWriter writer(&output);
+    const bool decoded = decodeArchive(&input, [&](const char* data, qint64 size) {
+        if (!scanner.feed(data, size, error)) {
+            return false;
+        }
+        if (!writer.write(data, size)) {
+            *error = writer.errorString();
+            return false;
+        }
+        return true;
+    }, error);
+    if (!decoded) {
+        output.cancelWriting();
+        return false;
+    }
+    if (!writer.finish()) {
+        *error = writer.errorString();
+        output.cancelWriting();
+        return false;
+    }
+
+    result.m_archiveSize = output.size();
+    for (const BgzfWriter::Block& block : writer.blocks()) {
+        Block entry;
+        entry.compressedOffset = block.compressedOffset;
+        entry.tarOffset = block.uncompressedOffset;
+        result.m_blocks.append(entry);
+    }
+    if (!output.commit()) {
+        *error = QString("Не удалось записать '%1': %2").arg(outputPath, output.errorString());
+        return false;
+    }
+    if (!result.save(pathFor(outputPath), error)) {
+        return false;
+    }
+    if (index) {
+        *index = result;
+    }
+    return true;
+}
+
+bool ArchiveIndex::scan(const QString& archivePath, ArchiveIndex* index, QString* error) {
+    QFile input(archivePath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        *error = QString("Не удалось открыть архив '%1': %2").arg(archivePath, input.errorString());
+        return false;
+    }
+    ArchiveIndex result;
+    result.m_archiveSize = input.size();
+    TarScanner scanner(&result.m_entries);
+    if (!decodeArchive(&input, [&](const char* data, qint64 size) { return scanner.feed(data, size, error); }, error)) {
+        return false;
+    }
+    *index = result;
+    return true;
+}
+
+bool ArchiveIndex::load(const QString& path, QString* error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint64 archiveSize = 0;
+    quint32 blockCount = 0;
+    stream >> magic >> version >> archiveSize >> blockCount;
+    if (magic != kIndexMagic || version != kIndexVersion) {
+        if (error) { *error = QString("Индекс архива '%1' устарел или повреждён").arg(path); }
+        return false;
+    }
+
+    QVector<Block> blocks;
+    blocks.reserve(static_cast<int>(qMin<quint32>(blockCount, 1u << 20)));
+    for (quint32 i = 0; i < blockCount && stream.status() == QDataStream::Ok; ++i) {
+        Block block;
+        stream >> block.compressedOffset >> block.tarOffset;
+        blocks.append(block);
+    }
+    quint32 entryCount = 0;
+    stream >> entryCount;
+    QList<ArchiveEntry> entries;
+    entries.reserve(static_cast<int>(qMin<quint32>(entryCount, 1u << 20)));
+    for (quint32 i = 0; i < entryCount && stream.status() == QDataStream::Ok; ++i) {
+        ArchiveEntry entry;
+        qint8 type = 0;
+        qint32 mode = 0;
+        stream >> entry.path >> type >> entry.size >> mode >> entry.mtime >> entry.linkTarget >> entry.offset >> entry.end;
+        entry.type = static_cast<char>(type);
+        entry.mode = mode;
+        entries.append(entry);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        if (error) { *error = QString("Индекс архива '%1' повреждён").arg(path); }
+        return false;
+    }
+    m_archiveSize = archiveSize;
+    m_blocks.swap(blocks);
+    m_entries.swap(entries);
+    return true;
+}
+
+bool ArchiveIndex::save(const QString& path, QString* error) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << kIndexMagic << kIndexVersion << m_archiveSize << quint32(m_blocks.size());
+    for (const Block& block : m_blocks) {
+        stream << block.compressedOffset << block.tarOffset;
+    }
+    stream << quint32(m_entries.size());
+    for (const ArchiveEntry& entry : m_entries) {
+        stream << entry.path << qint8(entry.type) << entry.size << qint32(entry.mode) << entry.mtime
+               << entry.linkTarget << entry.offset << entry.end;
+    }
+    if (!file.commit()) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    return true;
+}
+
+ArchiveIndex::Block ArchiveIndex::blockFor(qint64 tarOffset) const {
+    // Последний блок, начинающийся не позже tarOffset
+    const auto it = std::upper_bound(m_blocks.constBegin(), m_blocks.constEnd(), tarOffset,
+                                     [](qint64 offset, const Block& block) { return offset < block.tarOffset; });
+    return it == m_blocks.constBegin() ? Block() : *(it - 1);
+}
+
+qint64 ArchiveIndex::compressedEnd(qint64 tarOffset) const {
+    // Первый блок, начинающийся не раньше tarOffset
+    const auto it = std::lower_bound(m_blocks.constBegin(), m_blocks.constEnd(), tarOffset,
+                                     [](const Block& block, qint64 offset) { return block.tarOffset < offset; });
+    return it == m_blocks.constEnd() ? m_archiveSize : it->compressedOffset;
+}
+
+QList<ArchiveEntry> ArchiveIndex::select(const QStringList& paths) const {
+    QStringList prefixes;
+    for (const QString& path : paths) {
+        prefixes.append(QDir::cleanPath(path));
+    }
+    const auto matches = [&prefixes](const QString& path) {
+        for (const QString& prefix : prefixes) {
+            if (prefix == "." || path == prefix || path.startsWith(prefix + '/')) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    QSet<QString> linkTargets;
+    for (const ArchiveEntry& entry : m_entries) {
+        if (entry.type == '1' && matches(entry.path)) {
+            linkTargets.insert(QDir::cleanPath(entry.linkTarget));
+        }
+    }
+    QList<ArchiveEntry> selected;
+    for (const ArchiveEntry& entry : m_entries) {
+        if (matches(entry.path) || (entry.type == '0' && linkTargets.contains(entry.path))) {
+            selected.append(entry);
+        }
+    }
+    return selected;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Запись tar в индексе архива
+struct ArchiveEntry {
+    QString path;           // Путь в архиве после QDir::cleanPath
+    char type = '0';        // Тип записи tar: '0' файл, '1' жёсткая ссылка, '2' символическая, '5' каталог
+    qint64 size = 0;
+    int mode = 0;
+    qint64 mtime = 0;
+    QString linkTarget;
+    qint64 offset = 0;      // Начало записи в tar, включая служебные заголовки GNU longname / pax
+    qint64 end = 0;         // Конец данных записи с выравниванием до блока
+};
+
+// Индекс архива с произвольным доступом: записи tar с их смещениями и начала блоков
+// BGZF (точки входа в сжатый поток). По нему список содержимого читается без распаковки,
+// а выбранные записи распаковываются с ближайшего блока - объём работы пропорционален
+// выбранному, а не положению записей в архиве.
+// Индекс лежит рядом с архивом (pathFor()) и строится при сборке (makeSeekable()).
+class ArchiveIndex {
+public:
+    struct Block {
+        qint64 compressedOffset = 0;
+        qint64 tarOffset = 0;
+    };
+
+    // Файл индекса архива: <архив>.pkidx (для ресурсов Qt - такой же ресурс)
+    static QString pathFor(const QString& archivePath);
+
+    // Перепаковывает архив любого поддерживаемого формата в BGZF и сохраняет индекс
+    // в pathFor(outputPath)
+    static bool makeSeekable(const QString& inputPath, const QString& outputPath, ArchiveIndex* index, QString* error);
+    // Только список записей, с полной распаковкой архива; блоков в таком индексе нет
+    static bool scan(const QString& archivePath, ArchiveIndex* index, QString* error);
+
+    bool load(const QString& path, QString* error = nullptr);
+    bool save(const QString& path, QString* error = nullptr) const;
+
+    // Размер сжатого архива, для которого построен индекс
+    qint64 archiveSize() const { return m_archiveSize; }
+    const QList<ArchiveEntry>& entries() const { return m_entries; }
+    const QVector<Block>& blocks() const { return m_blocks; }
+    bool isSeekable() const { return !m_blocks.isEmpty(); }
+    // Блок, с которого начинается распаковка для данного смещения в tar
+    Block blockFor(qint64 tarOffset) const;
+    // Конец сжатых данных, нужных для распаковки tar до tarOffset
+    qint64 compressedEnd(qint64 tarOffset) const;
+
+    // Записи, входящие в выбранные пути (файл или каталог целиком), и файлы, на которые
+    // ссылаются выбранные жёсткие ссылки. Порядок - как в архиве
+    QList<ArchiveEntry> select(const QStringList& paths) const;
+
+private:
+    qint64 m_archiveSize = 0;
+    QList<ArchiveEntry> m_entries;
+    QVector<Block> m_blocks;
+};
\ No newline at end of file
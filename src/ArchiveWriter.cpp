@@ -0,0 +1,302 @@
+#include "ArchiveWriter.h"
+
+#include <QIODevice>
+
+#include <cstring>
+#include <zlib.h>
+
+namespace {
+
+constexpr int kTarBlockSize = 512;
+constexpr int kDeflateChunk = 256 * 1024;
+// Данные блока BGZF: с заголовком и хвостом член должен уложиться в 64 КБ даже несжатым
+constexpr int kBgzfBlockInput = 0xff00;
+constexpr int kBgzfHeaderSize = 18;
+constexpr int kBgzfMaxBlockSize = 0x10000;
+
+void putLittleEndian(char* data, quint32 value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        data[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+// Восьмеричное поле с завершающим нулём; слишком большие значения - base-256 (GNU)
+void putNumeric(char* field, int length, qint64 value) {
+    const qint64 limit = qint64(1) << (3 * (length - 1));
+    if (value >= 0 && value < limit) {
+        for (int i = length - 2; i >= 0; --i) {
+            field[i] = static_cast<char>('0' + (value & 7));
+            value >>= 3;
+        }
+        field[length - 1] = '\0';
+        return;
+    }
+    for (int i = length - 1; i > 0; --i) {
+        field[i] = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+    field[0] = static_cast<char>(0x80);
+}
+
+void putString(char* field, int length, const QByteArray& value) {
+    std::memcpy(field, value.constData(), static_cast<size_t>(qMin(length, value.size())));
+}
+
+} // namespace
+
+TarWriter::TarWriter(Sink sink) : m_sink(std::move(sink)) {}
+
+bool TarWriter::addDirectory(const QString& path, int mode, qint64 mtime) {
+    QString name = path;
+    if (!name.endsWith('/')) {
+        name += '/';
+    }
+    return writeHeader(name, '5', 0, mode, mtime);
+}
+
+bool TarWriter::addFile(const QString& path, const QByteArray& data, int mode, qint64 mtime) {
+    return beginFile(path, data.size(), mode, mtime) && writeData(data.constData(), data.size()) && endFile();
+}
+
+bool TarWriter::addSymlink(const QString& path, const QString& target, qint64 mtime) {
+    return writeHeader(path, '2', 0, 0777, mtime, target);
+}
+
+bool TarWriter::beginFile(const QString& path, qint64 size, int mode, qint64 mtime) {
+    if (!writeHeader(path, '0', size, mode, mtime)) {
+        return false;
+    }
+    m_fileRemaining = size;
+    m_filePadding = (kTarBlockSize - size % kTarBlockSize) % kTarBlockSize;
+    return true;
+}
+
+bool TarWriter::writeData(const char* data, qint64 size) {
+    if (size > m_fileRemaining) {
+        return false;
+    }
+    m_fileRemaining -= size;
+    return writeRaw(data, size);
+}
+
+bool TarWriter::endFile() {
+    if (m_fileRemaining != 0) {
+        return false;
+    }
+    const qint64 padding = m_filePadding;
+    m_filePadding = 0;
+    return writePadding(padding);
+}
+
+bool TarWriter::finish() {
+    return writePadding(2 * kTarBlockSize);
+}
+
+bool TarWriter::writeHeader(const QString& path, char type, qint64 size, int mode, qint64 mtime, const QString& linkTarget) {
+    const QByteArray name = path.toUtf8();
+    const QByteArray link = linkTarget.toUtf8();
+
+    // Имена длиннее поля передаются отдельной записью GNU 'L' ('K' для цели ссылки)
+    if (name.size() > 100 && !writeHeader("././@LongLink", 'L', name.size() + 1, 0644, 0)) {
+        return false;
+    }
+    if (name.size() > 100 && (!writeRaw(name.constData(), name.size() + 1) ||
+                              !writePadding((kTarBlockSize - (name.size() + 1) % kTarBlockSize) % kTarBlockSize))) {
+        return false;
+    }
+    if (link.size() > 100 && !writeHeader("././@LongLink", 'K', link.size() + 1, 0644, 0)) {
+        return false;
+    }
+    if (link.size() > 100 && (!writeRaw(link.constData(), link.size() + 1) ||
+                              !writePadding((kTarBlockSize - (link.size() + 1) % kTarBlockSize) % kTarBlockSize))) {
+        return false;
+    }
+
+    char header[kTarBlockSize];
+    std::memset(header, 0, sizeof(header));
+    putString(header, 100, name);
+    putNumeric(header + 100, 8, mode & 07777);
+    putNumeric(header + 108, 8, 0);
+    putNumeric(header + 116, 8, 0);
+    putNumeric(header + 124, 12, size);
+    putNumeric(header + 136, 12, mtime);
+    std::memset(header + 148, ' ', 8);
+    header[156] = type;
+    putString(header + 157, 100, link);
+    std::memcpy(header + 257, "ustar  ", 8); // Магия GNU: "ustar  \0"
+
+    unsigned int checksum = 0;
+    for (int i = 0; i < kTarBlockSize; ++i) {
+        checksum += static_cast<unsigned char>(header[i]);
+    }
+    putNumeric(header + 148, 7, checksum);
+    header[155] = ' ';
+
+    return writeRaw(header, kTarBlockSize);
+}
+
+bool TarWriter::writeRaw(const char* data, qint64 size) {
+    if (size <= 0) {
+        return true;
+    }
+    if (!m_sink(data, size)) {
+        return false;
+    }
+    m_bytesWritten += size;
+    return true;
+}
+
+bool TarWriter::writePadding(qint64 size) {
+    static const char zeros[kTarBlockSize] = {};
+    while (size > 0) {
+        const qint64 chunk = qMin<qint64>(size, kTarBlockSize);
+        if (!writeRaw(zeros, chunk)) {
+            return false;
+        }
+        size -= chunk;
+    }
+    return true;
+}
+
+GzipWriter::GzipWriter(QIODevice* device, int level) : m_device(device), m_stream(new z_stream_s) {
+    std::memset(m_stream, 0, sizeof(z_stream_s));
+    // 15 + 16: заголовок и контрольная сумма gzip
+    if (deflateInit2(m_stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        m_error = "Не удалось инициализировать zlib";
+    }
+    m_outBuffer.resize(kDeflateChunk);
+}
+
+GzipWriter::~GzipWriter() {
+    deflateEnd(m_stream);
+    delete m_stream;
+}
+
+bool GzipWriter::write(const char* data, qint64 size) {
+    while (size > 0 && m_error.isEmpty()) {
+        const qint64 slice = qMin<qint64>(size, 64 * 1024 * 1024);
+        m_stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        m_stream->avail_in = static_cast<uInt>(slice);
+        if (!deflateInput(Z_NO_FLUSH)) {
+            return false;
+        }
+        data += slice;
+        size -= slice;
+    }
+    return m_error.isEmpty();
+}
+
+bool GzipWriter::finish() {
+    if (m_finished) {
+        return m_error.isEmpty();
+    }
+    m_finished = true;
+    m_stream->next_in = nullptr;
+    m_stream->avail_in = 0;
+    return deflateInput(Z_FINISH);
+}
+
+bool GzipWriter::deflateInput(int flush) {
+    for (;;) {
+        m_stream->next_out = reinterpret_cast<Bytef*>(m_outBuffer.data());
+        m_stream->avail_out = static_cast<uInt>(m_outBuffer.size());
+        const int rc = deflate(m_stream, flush);
+        if (rc == Z_STREAM_ERROR) {
+            m_error = "Ошибка сжатия zlib";
+            return false;
+        }
+        const qint64 produced = m_outBuffer.size() - m_stream->avail_out;
+        if (produced > 0 && m_device->write(m_outBuffer.constData(), produced) != produced) {
+            m_error = m_device->errorString();
+            return false;
+        }
+        if (flush == Z_FINISH ? rc == Z_STREAM_END : (m_stream->avail_in == 0 && m_stream->avail_out != 0)) {
+            return true;
+        }
+    }
+}
+
+BgzfWriter::BgzfWriter(QIODevice* device, int level) : m_device(device), m_level(level) {
+    m_input.reserve(kBgzfBlockInput);
+    m_output.resize(kBgzfMaxBlockSize);
+}
+
+bool BgzfWriter::write(const char* data, qint64 size) {
+    while (size > 0 && m_error.isEmpty()) {
+        const int take = static_cast<int>(qMin<qint64>(size, kBgzfBlockInput - m_input.size()));
+        m_input.append(data, take);
+        data += take;
+        size -= take;
+        if (m_input.size() == kBgzfBlockInput && !flushBlock()) {
+            return false;
+        }
+    }
+    return m_error.isEmpty();
+}
+
+bool BgzfWriter::finish() {
+    if (m_finished) {
+        return m_error.isEmpty();
+    }
+    m_finished = true;
+    // Пустой блок в конце - признак того, что файл BGZF не обрезан
+    return (m_input.isEmpty() || flushBlock()) && flushBlock();
+}
+
+bool BgzfWriter::flushBlock() {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // Сырой deflate: заголовок gzip с полем 'BC' пишется вручную
+    if (deflateInit2(&stream, m_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        m_error = "Не удалось инициализировать zlib";
+        return false;
+    }
+    const int capacity = kBgzfMaxBlockSize - kBgzfHeaderSize - 8;
+    stream.next_in = reinterpret_cast<Bytef*>(m_input.data());
+    stream.avail_in = static_cast<uInt>(m_input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(m_output.data() + kBgzfHeaderSize);
+    stream.avail_out = static_cast<uInt>(capacity);
+    int rc = deflate(&stream, Z_FINISH);
+    if (rc != Z_STREAM_END) {
+        // Несжимаемые данные: блок хранится как есть и всё равно укладывается в 64 КБ
+        deflateReset(&stream);
+        deflateParams(&stream, 0, Z_DEFAULT_STRATEGY);
+        stream.next_in = reinterpret_cast<Bytef*>(m_input.data());
+        stream.avail_in = static_cast<uInt>(m_input.size());
+        stream.next_out = reinterpret_cast<Bytef*>(m_output.data() + kBgzfHeaderSize);
+        stream.avail_out = static_cast<uInt>(capacity);
+        rc = deflate(&stream, Z_FINISH);
+    }
+    const int compressedSize = capacity - static_cast<int>(stream.avail_out);
+    deflateEnd(&stream);
+    if (rc != Z_STREAM_END) {
+        m_error = "Ошибка сжатия zlib";
+        return false;
+    }
+
+    static const char header[kBgzfHeaderSize] = {
+        '\x1f', '\x8b', 8, 4, 0, 0, 0, 0, 0, '\xff', 6, 0, 'B', 'C', 2, 0, 0, 0
+    };
+    char* block = m_output.data();
+    std::memcpy(block, header, kBgzfHeaderSize);
+    const int blockSize = kBgzfHeaderSize + compressedSize + 8;
+    putLittleEndian(block + 16, static_cast<quint32>(blockSize - 1), 2);
+    const uLong crc = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(m_input.constData()), static_cast<uInt>(m_input.size()));
+    putLittleEndian(block + kBgzfHeaderSize + compressedSize, static_cast<quint32>(crc), 4);
+    putLittleEndian(block + kBgzfHeaderSize + compressedSize + 4, static_cast<quint32>(m_input.size()), 4);
+    if (m_device->write(block, blockSize) != blockSize) {
+        m_error = m_device->errorString();
+        return false;
+    }
+
+    if (!m_input.isEmpty()) {
+        Block entry;
+        entry.compressedOffset = m_compressedOffset;
+        entry.uncompressedOffset = m_uncompressedOffset;
+        m_blocks.append(entry);
+    }
+    m_compressedOffset += blockSize;
+    m_uncompressedOffset += m_input.size();
+    m_input.clear();
+    return true;
+}
\ No newline at end of file
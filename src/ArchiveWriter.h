@@ -0,0 +1,104 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+class QIODevice;
+struct z_stream_s;
+
+// Запись архивов tar (GNU-совместимый ustar, длинные имена через записи 'L').
+// Используется инструментами сборки пакетов и бенчмарком; данные отдаются в приёмник,
+// которым обычно служит GzipWriter.
+class TarWriter {
+public:
+    // Приёмник байтов tar; false - ошибка записи
+    using Sink = std::function<bool(const char* data, qint64 size)>;
+
+    explicit TarWriter(Sink sink);
+
+    bool addDirectory(const QString& path, int mode = 0755, qint64 mtime = 0);
+    bool addFile(const QString& path, const QByteArray& data, int mode = 0644, qint64 mtime = 0);
+    bool addSymlink(const QString& path, const QString& target, qint64 mtime = 0);
+
+    // Потоковая запись большого файла: beginFile, затем writeData на весь size, затем endFile
+    bool beginFile(const QString& path, qint64 size, int mode = 0644, qint64 mtime = 0);
+    bool writeData(const char* data, qint64 size);
+    bool endFile();
+
+    // Завершающие нулевые блоки
+    bool finish();
+
+    qint64 bytesWritten() const { return m_bytesWritten; }
+
+private:
+    bool writeHeader(const QString& path, char type, qint64 size, int mode, qint64 mtime, const QString& linkTarget = QString());
+    bool writeRaw(const char* data, qint64 size);
+    bool writePadding(qint64 size);
+
+    Sink m_sink;
+    qint64 m_bytesWritten = 0;
+    qint64 m_fileRemaining = 0;
+    qint64 m_filePadding = 0;
+};
+
+// Потоковое сжатие gzip в QIODevice
+class GzipWriter {
+public:
+    explicit GzipWriter(QIODevice* device, int level = 6);
+    ~GzipWriter();
+
+    GzipWriter(const GzipWriter&) = delete;
+    GzipWriter& operator=(const GzipWriter&) = delete;
+
+    bool write(const char* data, qint64 size);
+    // Сбрасывает остаток и пишет завершение потока gzip
+    bool finish();
+
+    QString errorString() const { return m_error; }
+
+private:
+    bool deflateInput(int flush);
+
+    QIODevice* m_device;
+    z_stream_s* m_stream;
+    QByteArray m_outBuffer;
+    QString m_error;
+    bool m_finished = false;
+};
+
+// Запись блочного gzip (BGZF): независимые члены gzip не больше 64 КБ, сжатый размер
+// каждого - в поле FEXTRA 'BC'. Такой архив читает любой gzip, ParallelInflater
+// разжимает его параллельно, а распаковку можно начать с любого блока
+class BgzfWriter {
+public:
+    // Начало блока в сжатом файле и в исходных данных
+    struct Block {
+        qint64 compressedOffset = 0;
+        qint64 uncompressedOffset = 0;
+    };
+
+    explicit BgzfWriter(QIODevice* device, int level = 6);
+
+    bool write(const char* data, qint64 size);
+    // Сбрасывает последний блок и пишет пустой завершающий блок BGZF
+    bool finish();
+
+    const QVector<Block>& blocks() const { return m_blocks; }
+    QString errorString() const { return m_error; }
+
+private:
+    bool flushBlock();
+
+    QIODevice* m_device;
+    int m_level;
+    QByteArray m_input;
+    QByteArray m_output;
+    qint64 m_compressedOffset = 0;
+    qint64 m_uncompressedOffset = 0;
+    QVector<Block> m_blocks;
+    QString m_error;
+    bool m_finished = false;
+};
\ No newline at end of file
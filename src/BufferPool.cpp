@@ -0,0 +1,34 @@
+#include "BufferPool.h"
+
+#include <QMutexLocker>
+
+BufferPool::BufferPool(qint64 bufferSize, int capacity)
+    : m_bufferSize(bufferSize), m_capacity(qMax(1, capacity)) {
+    m_storage.reserve(static_cast<size_t>(m_capacity));
+    m_free.reserve(static_cast<size_t>(m_capacity));
+}
+
+char* BufferPool::acquire() {
+    QMutexLocker lock(&m_mutex);
+    while (m_free.empty() && static_cast<int>(m_storage.size()) >= m_capacity) {
+        m_released.wait(&m_mutex);
+    }
+    if (!m_free.empty()) {
+        char* buffer = m_free.back();
+        m_free.pop_back();
+        return buffer;
+    }
+    m_storage.emplace_back(new char[static_cast<size_t>(m_bufferSize)]);
+    return m_storage.back().get();
+}
+
+void BufferPool::release(char* buffer) {
+    QMutexLocker lock(&m_mutex);
+    m_free.push_back(buffer);
+    m_released.wakeOne();
+}
+
+qint64 BufferPool::allocatedBytes() const {
+    QMutexLocker lock(&m_mutex);
+    return static_cast<qint64>(m_storage.size()) * m_bufferSize;
+}
\ No newline at end of file
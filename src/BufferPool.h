@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <memory>
+#include <vector>
+
+// Пул буферов одного размера для конвейера установки. Буферы выделяются по мере нужды,
+// но не больше capacity() и затем только переиспользуются. Когда все заняты, acquire()
+// ждёт возврата: более быстрый этап конвейера упирается в более медленный, и объём
+// данных между этапами не растёт с размером архива.
+// Методы потокобезопасны.
+class BufferPool {
+public:
+    BufferPool(qint64 bufferSize, int capacity);
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Свободный буфер; ждёт, пока его не вернут, если заняты все
+    char* acquire();
+    void release(char* buffer);
+
+    qint64 bufferSize() const { return m_bufferSize; }
+    int capacity() const { return m_capacity; }
+    // Сколько памяти выделено на данный момент
+    qint64 allocatedBytes() const;
+
+private:
+    const qint64 m_bufferSize;
+    const int m_capacity;
+    mutable QMutex m_mutex;
+    QWaitCondition m_released;
+    std::vector<std::unique_ptr<char[]>> m_storage;
+    std::vector<char*> m_free;
+};
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "CliInstaller.h"
+#include "ArchiveIndex.h"
+#include "DeltaPackage.h"
+#include "PackageManager.h"
+#include "ResourceBundles.h"
+#include "Trace.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QTimer>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Временный поток сбрасывается при разрушении, поэтому строки выводятся сразу
+void printLine(FILE* file, const QString& line) {
+    QTextStream stream(file);
+    stream << line << '\n';
+}
+
+} // namespace
+
+CliInstaller::CliInstaller(QObject *parent) : QObject(parent) {
+    m_packageManager = new PackageManager(this);
+    connect(m_packageManager, &PackageManager::installationFinished, this, &CliInstaller::onInstallationFinished);
+    connect(m_packageManager, &PackageManager::installationCancelled, this, [this](const QString& packageName, const QString& message) {
+        ++m_failed;
+        printLine(stderr, "ОТМЕНЕНО\t" + packageName + ": " + message);
+    });
+    connect(m_packageManager, &PackageManager::allInstallationsFinished, this, &CliInstaller::finish);
+    connect(m_packageManager, &PackageManager::statusMessage, this, [this](const QString& message) {
+        if (m_verbose) {
+            printLine(stderr, message);
+        }
+    });
+}
+
+bool CliInstaller::isCliInvocation(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--install") == 0 || std::strcmp(argv[i], "--list") == 0 ||
+            std::strcmp(argv[i], "--make-delta") == 0 || std::strcmp(argv[i], "--make-seekable") == 0 ||
+            std::strcmp(argv[i], "--contents") == 0 || std::strcmp(argv[i], "--update-manifest") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int CliInstaller::run(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    ResourceBundles::setSearchPath(QCoreApplication::applicationDirPath());
+    Trace::configureFromEnvironment();
+
+    CliInstaller installer;
+    int exitCode = installer.start(app.arguments());
+    if (exitCode < 0) {
+        exitCode = app.exec();
+    }
+    QString traceError;
+    if (!Trace::writeRequested(&traceError)) {
+        printLine(stderr, "Не удалось сохранить трассировку: " + traceError);
+    }
+    return exitCode;
+}
+
+int CliInstaller::start(const QStringList& arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Установка пакетов без графического интерфейса");
+    parser.addHelpOption();
+    parser.addOption({"install", "Установить пакеты, перечисленные в аргументах."});
+    parser.addOption({"list", "Вывести список доступных пакетов и выйти."});
+    parser.addOption({"make-delta", "Собрать дельта-пакет из двух распакованных версий: <базовая папка> <новая папка>."});
+    parser.addOption({"make-seekable", "Перепаковать архив из аргумента в BGZF с индексом записей (<файл>.pkidx)."});
+    parser.addOption({"update-manifest", "Пересчитать суммы sha256 в <манифесте> для архивов из аргументов вида <resourcePath>=<файл>.", "манифест"});
+    parser.addOption({{"o", "output"}, "Выходной файл для --make-delta, --make-seekable и --update-manifest.", "файл"});
+    parser.addOption({"contents", "Вывести содержимое архивов пакетов, перечисленных в аргументах."});
+    parser.addOption({"path", "С --install: распаковать только этот путь архива (можно указать несколько раз).", "путь"});
+    parser.addOption({{"r", "root"}, "Корневая папка установки (по умолчанию ~/MyInstalledApps).", "папка"});
+    parser.addOption({{"j", "jobs"}, "Наибольшее число одновременных установок.", "число"});
+    parser.addOption({"store", "Хранить одинаковые файлы пакетов и версий один раз в хранилище содержимого."});
+    parser.addOption({"memory", "Память под буферы распаковки всех одновременных установок, МБ (по умолчанию 256).", "МБ"});
+    parser.addOption({{"v", "verbose"}, "Выводить сообщения о ходе установки в stderr."});
+    parser.addOption({"trace", "Записать трассировку конвейера в <файл> в формате Chrome trace JSON.", "файл"});
+    parser.addPositionalArgument("packages", "Идентификаторы пакетов.", "[id...]");
+
+    if (!parser.parse(arguments)) {
+        printLine(stderr, parser.errorText());
+        return ExitUsage;
+    }
+    if (parser.isSet("help")) {
+        QTextStream(stdout) << parser.helpText();
+        return ExitSuccess;
+    }
+    m_verbose = parser.isSet("verbose");
+    if (parser.isSet("trace")) {
+        Trace::requestOutput(parser.value("trace"));
+    }
+
+    if (parser.isSet("make-delta")) {
+        if (parser.positionalArguments().size() != 2 || !parser.isSet("output")) {
+            printLine(stderr, "Использование: --make-delta <базовая папка> <новая папка> --output <файл>");
+            return ExitUsage;
+        }
+        return makeDelta(parser.positionalArguments(), parser.value("output"));
+    }
+    if (parser.isSet("make-seekable")) {
+        if (parser.positionalArguments().size() != 1 || !parser.isSet("output")) {
+            printLine(stderr, "Использование: --make-seekable <архив> --output <файл>");
+            return ExitUsage;
+        }
+        return makeSeekable(parser.positionalArguments().first(), parser.value("output"));
+    }
+    if (parser.isSet("update-manifest")) {
+        if (!parser.isSet("output")) {
+            printLine(stderr, "Использование: --update-manifest <манифест> --output <файл> [<resourcePath>=<архив>...]");
+            return ExitUsage;
+        }
+        return updateManifest(parser.value("update-manifest"), parser.positionalArguments(), parser.value("output"));
+    }
+
+    if (parser.isSet("list")) {
+        const PackageCatalog& catalog = m_packageManager->catalog();
+        for (const PackageInfo& package : catalog.packages()) {
+            printLine(stdout, package.id + '\t' + package.displayName);
+        }
+        return ExitSuccess;
+    }
+
+    const QStringList ids = parser.positionalArguments();
+    if (ids.isEmpty()) {
+        printLine(stderr, "Не указаны пакеты");
+        return ExitUsage;
+    }
+    if (parser.isSet("root")) {
+        m_packageManager->setInstallRoot(parser.value("root"));
+    }
+    if (parser.isSet("jobs")) {
+        bool ok = false;
+        const int jobs = parser.value("jobs").toInt(&ok);
+        if (!ok || jobs <= 0) {
+            printLine(stderr, "Неверное значение --jobs: " + parser.value("jobs"));
+            return ExitUsage;
+        }
+        m_packageManager->setMaxConcurrentInstalls(jobs);
+    }
+    if (parser.isSet("memory")) {
+        bool ok = false;
+        const qint64 megabytes = parser.value("memory").toLongLong(&ok);
+        if (!ok || megabytes <= 0) {
+            printLine(stderr, "Неверное значение --memory: " + parser.value("memory"));
+            return ExitUsage;
+        }
+        m_packageManager->setMemoryBudget(megabytes * 1024 * 1024);
+    }
+    m_packageManager->setContentStoreEnabled(parser.isSet("store"));
+
+    // Сначала проверяем все id, чтобы не начинать частичную установку
+    QList<const PackageInfo*> packages;
+    for (const QString& id : ids) {
+        const PackageInfo* package = m_packageManager->findPackage(id);
+        if (!package) {
+            printLine(stderr, "Неизвестный пакет: " + id);
+            return ExitUnknownPackage;
+        }
+        packages.append(package);
+    }
+    if (parser.isSet("contents")) {
+        return listContents(packages);
+    }
+    for (const PackageInfo* package : packages) {
+        m_packageManager->installPackage(*package, parser.values("path"));
+    }
+
+    // Все пакеты могли быть отклонены сразу, тогда очередь пуста и сигнала о её окончании не будет
+    if (!m_packageManager->isBusy()) {
+        QTimer::singleShot(0, this, &CliInstaller::finish);
+    }
+    return -1;
+}
+
+int CliInstaller::makeDelta(const QStringList& directories, const QString& outputPath) {
+    DeltaBuilder::Stats stats;
+    QString error;
+    if (!DeltaBuilder::build(directories.at(0), directories.at(1), outputPath, &stats, &error)) {
+        printLine(stderr, error);
+        return ExitBuildFailed;
+    }
+    printLine(stdout, QString("без изменений %1, добавлено %2, с патчем %3, удалено %4, байт tar %5")
+                          .arg(stats.unchanged).arg(stats.added).arg(stats.patched).arg(stats.removed)
+                          .arg(stats.bytesWritten));
+    return ExitSuccess;
+}
+
+int CliInstaller::makeSeekable(const QString& inputPath, const QString& outputPath) {
+    ArchiveIndex index;
+    QString error;
+    if (!ArchiveIndex::makeSeekable(inputPath, outputPath, &index, &error)) {
+        printLine(stderr, error);
+        return ExitBuildFailed;
+    }
+    printLine(stdout, QString("записей %1, блоков %2, байт архива %3")
+                          .arg(index.entries().size()).arg(index.blocks().size()).arg(index.archiveSize()));
+    return ExitSuccess;
+}
+
+int CliInstaller::updateManifest(const QString& manifestPath, const QStringList& archives, const QString& outputPath) {
+    // Архивы, перепакованные при сборке (--make-seekable), отличаются от исходных побайтно:
+    // сумма из манифеста заменяется суммой того файла, который попадёт в бандл
+    QHash<QString, QString> archiveFiles;
+    for (const QString& argument : archives) {
+        const int separator = argument.indexOf('=');
+        if (separator <= 0) {
+            printLine(stderr, "Ожидается <resourcePath>=<архив>: " + argument);
+            return ExitUsage;
+        }
+        archiveFiles.insert(argument.left(separator), argument.mid(separator + 1));
+    }
+
+    QFile input(manifestPath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        printLine(stderr, QString("Не удалось открыть '%1': %2").arg(manifestPath, input.errorString()));
+        return ExitBuildFailed;
+    }
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(input.readAll(), &parseError);
+    if (!document.isObject()) {
+        printLine(stderr, QString("Ошибка в манифесте '%1': %2").arg(manifestPath, parseError.errorString()));
+        return ExitBuildFailed;
+    }
+
+    QJsonObject root = document.object();
+    QJsonArray packages = root.value("packages").toArray();
+    int updated = 0;
+    for (int i = 0; i < packages.size(); ++i) {
+        QJsonObject package = packages.at(i).toObject();
+        const auto archive = archiveFiles.constFind(package.value("resourcePath").toString());
+        // Пакеты без суммы в манифесте не проверяются - и пересчитывать нечего
+        if (archive == archiveFiles.constEnd() || package.value("sha256").toString().isEmpty()) {
+            continue;
+        }
+        QFile file(archive.value());
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        if (!file.open(QIODevice::ReadOnly) || !hash.addData(&file)) {
+            printLine(stderr, QString("Не удалось прочитать '%1': %2").arg(archive.value(), file.errorString()));
+            return ExitBuildFailed;
+        }
+        package.insert("sha256", QString::fromLatin1(hash.result().toHex()));
+        packages.replace(i, package);
+        ++updated;
+    }
+    root.insert("packages", packages);
+
+    QSaveFile output(outputPath);
+    if (!output.open(QIODevice::WriteOnly) || output.write(QJsonDocument(root).toJson()) < 0 || !output.commit()) {
+        printLine(stderr, QString("Не удалось записать '%1': %2").arg(outputPath, output.errorString()));
+        return ExitBuildFailed;
+    }
+    printLine(stdout, QString("пересчитано сумм: %1").arg(updated));
+    return ExitSuccess;
+}
+
+int CliInstaller::listContents(const QList<const PackageInfo*>& packages) {
+    for (const PackageInfo* package : packages) {
+        QList<ArchiveEntry> entries;
+        QString error;
+        if (!m_packageManager->listContents(*package, &entries, &error)) {
+            printLine(stderr, "ОШИБКА\t" + package->displayName + ": " + error);
+            return ExitInstallFailed;
+        }
+        for (const ArchiveEntry& entry : entries) {
+            printLine(stdout, QString("%1\t%2\t%3").arg(QChar(entry.type)).arg(entry.size).arg(entry.path));
+        }
+    }
+    return ExitSuccess;
+}
+
+void CliInstaller::onInstallationFinished(const QString& packageName, bool success, const QString& message) {
+    if (success) {
+        ++m_succeeded;
+        printLine(stdout, "ГОТОВО\t" + packageName);
+    } else {
+        ++m_failed;
+        printLine(stderr, "ОШИБКА\t" + packageName + ": " + message);
+    }
+}
+
+void CliInstaller::finish() {
+    QCoreApplication::exit(m_failed > 0 ? ExitInstallFailed : ExitSuccess);
+}
\ No newline at end of file
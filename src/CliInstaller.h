@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+class PackageManager;
+struct PackageInfo;
+
+// Пакетная установка из командной строки без GUI.
+// Работает под QCoreApplication и не затрагивает стек виджетов: подходит для
+// развёртывания по SSH без дисплея.
+class CliInstaller : public QObject {
+    Q_OBJECT
+
+public:
+    // Коды завершения процесса
+    enum ExitCode {
+        ExitSuccess = 0,
+        ExitInstallFailed = 1,  // Хотя бы один пакет не установлен
+        ExitUsage = 2,          // Неверные аргументы
+        ExitUnknownPackage = 3, // Пакет с указанным id не найден в каталоге
+        ExitBuildFailed = 4     // Не удалось собрать дельта-пакет, индекс архива или манифест
+    };
+
+    explicit CliInstaller(QObject *parent = nullptr);
+
+    // Есть ли в аргументах запрос headless-режима
+    // (--install/--list/--contents/--make-delta/--make-seekable/--update-manifest)
+    static bool isCliInvocation(int argc, char *argv[]);
+    // Полный цикл: создаёт QCoreApplication, разбирает аргументы, устанавливает пакеты
+    static int run(int argc, char *argv[]);
+
+private:
+    int start(const QStringList& arguments);
+    int makeDelta(const QStringList& directories, const QString& outputPath);
+    int makeSeekable(const QString& inputPath, const QString& outputPath);
+    int updateManifest(const QString& manifestPath, const QStringList& archives, const QString& outputPath);
+    int listContents(const QList<const PackageInfo*>& packages);
+    void onInstallationFinished(const QString& packageName, bool success, const QString& message);
+    void finish();
+
+    PackageManager* m_packageManager;
+    bool m_verbose = false;
+    int m_failed = 0;
+    int m_succeeded = 0;
+};
\ No newline at end of file
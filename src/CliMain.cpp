@@ -0,0 +1,7 @@
+#include "CliInstaller.h"
+
+// Отдельный исполняемый файл для headless-установки: собран только с QtCore,
+// поэтому не подгружает библиотеки виджетов и GUI при запуске
+int main(int argc, char *argv[]) {
+    return CliInstaller::run(argc, argv);
+}
\ No newline at end of file
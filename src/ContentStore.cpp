@@ -0,0 +1,290 @@
+#include "ContentStore.h"
+#include "InstalledIndex.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSet>
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace {
+
+QString objectName(const QByteArray& sha256, int mode) {
+    return QString::fromLatin1(sha256.toHex()) + '-' + QString::number(mode & 07777, 8);
+}
+
+// Имя готового объекта; всё прочее (временные файлы ingest(), служебные файлы) - не объекты
+bool isObjectName(const QString& name) {
+    static const QRegularExpression pattern("^[0-9a-f]{64}-[0-7]{1,4}$");
+    return pattern.match(name).hasMatch();
+}
+
+// Есть ли у файла другие жёсткие ссылки, кроме этой
+bool hasOtherLinks(const QString& path) {
+#ifdef Q_OS_UNIX
+    struct stat info;
+    return ::lstat(QFile::encodeName(path).constData(), &info) != 0 || info.st_nlink > 1;
+#else
+    Q_UNUSED(path);
+    return true;
+#endif
+}
+
+} // namespace
+
+ContentStore::ContentStore(const QString& rootPath) : m_rootPath(QDir::cleanPath(rootPath)) {}
+
+ContentStore::~ContentStore() {
+    unlock();
+}
+
+QString ContentStore::prunePendingPath() const {
+    return m_rootPath + "/.prune-pending";
+}
+
+bool ContentStore::isPrunePending() const {
+    return QFileInfo::exists(prunePendingPath());
+}
+
+QString ContentStore::defaultPathFor(const QString& installRoot) {
+    return QDir(installRoot).filePath(".packman/store");
+}
+
+QString ContentStore::objectPath(const QByteArray& sha256, int mode) const {
+    const QString name = objectName(sha256, mode);
+    // Первые два символа хэша - подпапка, чтобы в одной папке не было сотен тысяч файлов
+    return m_rootPath + '/' + name.left(2) + '/' + name;
+}
+
+#ifdef Q_OS_UNIX
+
+int ContentStore::openLockFile() const {
+    if (!QDir().mkpath(m_rootPath)) {
+        return -1;
+    }
+    return ::open(QFile::encodeName(m_rootPath + "/.lock").constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+}
+
+bool ContentStore::lockShared() {
+    if (m_lockFd >= 0) {
+        return true;
+    }
+    m_lockFd = openLockFile();
+    if (m_lockFd < 0) {
+        return false;
+    }
+    // Ждём только завершения чужой очистки - она короткая
+    while (::flock(m_lockFd, LOCK_SH) != 0) {
+        if (errno != EINTR) {
+            unlock();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ContentStore::unlock() {
+    if (m_lockFd >= 0) {
+        // Закрытие дескриптора снимает flock
+        ::close(m_lockFd);
+        m_lockFd = -1;
+    }
+}
+
+bool ContentStore::cloneFile(const QString& source, const QString& target) const {
+#ifdef Q_OS_LINUX
+    if (m_reflinkState.load(std::memory_order_relaxed) < 0) {
+        return false;
+    }
+    const int sourceFd = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (sourceFd < 0) {
+        return false;
+    }
+    const int targetFd = ::open(QFile::encodeName(target).constData(),
+                                O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+    bool cloned = false;
+    if (targetFd >= 0) {
+        cloned = ::ioctl(targetFd, FICLONE, sourceFd) == 0;
+        if (!cloned && (errno == EOPNOTSUPP || errno == ENOTTY || errno == EINVAL || errno == EXDEV)) {
+            // ФС без reflink: больше не пытаемся
+            m_reflinkState.store(-1, std::memory_order_relaxed);
+        } else if (cloned) {
+            m_reflinkState.store(1, std::memory_order_relaxed);
+        }
+        ::close(targetFd);
+        if (!cloned) {
+            ::unlink(QFile::encodeName(target).constData());
+        }
+    }
+    ::close(sourceFd);
+    return cloned;
+#else
+    Q_UNUSED(source);
+    Q_UNUSED(target);
+    return false;
+#endif
+}
+
+bool ContentStore::materialize(const QByteArray& sha256, int mode, qint64 mtime, const QString& path, qint64* actualMtime) const {
+    const QString object = objectPath(sha256, mode);
+    const QByteArray objectFile = QFile::encodeName(object);
+    struct stat objectStat;
+    if (::stat(objectFile.constData(), &objectStat) != 0) {
+        return false;
+    }
+    // Ссылка создаётся под временным именем и переименовывается: уже записанный файл
+    // (крупные файлы пишутся до того, как известен их хэш) не теряется при ошибке
+    const QString temporary = path + ".pkstore";
+    const QByteArray temporaryFile = QFile::encodeName(temporary);
+    ::unlink(temporaryFile.constData());
+
+    if (cloneFile(object, temporary)) {
+        // Клон - отдельный файл: права и время берутся из архива
+        struct timespec times[2];
+        times[0].tv_sec = 0;
+        times[0].tv_nsec = UTIME_OMIT;
+        times[1].tv_sec = static_cast<time_t>(mtime);
+        times[1].tv_nsec = 0;
+        ::chmod(temporaryFile.constData(), static_cast<mode_t>(mode & 07777));
+        ::utimensat(AT_FDCWD, temporaryFile.constData(), times, AT_SYMLINK_NOFOLLOW);
+        *actualMtime = mtime;
+    } else if (::link(objectFile.constData(), temporaryFile.constData()) == 0) {
+        *actualMtime = static_cast<qint64>(objectStat.st_mtime);
+    } else {
+        return false;
+    }
+    if (::rename(temporaryFile.constData(), QFile::encodeName(path).constData()) != 0) {
+        ::unlink(temporaryFile.constData());
+        return false;
+    }
+    return true;
+}
+
+bool ContentStore::ingest(const QString& path, const QByteArray& sha256, int mode) const {
+    const QString object = objectPath(sha256, mode);
+    if (QFileInfo::exists(object)) {
+        return true;
+    }
+    if (!QDir().mkpath(QFileInfo(object).absolutePath())) {
+        return false;
+    }
+    // Клон сначала пишется во временный файл: в хранилище не должно быть недописанных объектов
+    const QString temporary = object + QString(".tmp%1").arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    if (cloneFile(path, temporary)) {
+        ::chmod(QFile::encodeName(temporary).constData(), static_cast<mode_t>(mode & 07777));
+        if (::rename(QFile::encodeName(temporary).constData(), QFile::encodeName(object).constData()) == 0) {
+            return true;
+        }
+        ::unlink(QFile::encodeName(temporary).constData());
+        return false;
+    }
+    // Объект с тем же ключом мог появиться из другого потока - это не ошибка
+    return ::link(QFile::encodeName(path).constData(), QFile::encodeName(object).constData()) == 0 || errno == EEXIST;
+}
+
+#else // Q_OS_UNIX
+
+int ContentStore::openLockFile() const {
+    return -1;
+}
+
+bool ContentStore::lockShared() {
+    return true;
+}
+
+void ContentStore::unlock() {}
+
+bool ContentStore::cloneFile(const QString& source, const QString& target) const {
+    Q_UNUSED(source);
+    Q_UNUSED(target);
+    return false;
+}
+
+bool ContentStore::materialize(const QByteArray& sha256, int mode, qint64 mtime, const QString& path, qint64* actualMtime) const {
+    Q_UNUSED(sha256);
+    Q_UNUSED(mode);
+    Q_UNUSED(mtime);
+    Q_UNUSED(path);
+    Q_UNUSED(actualMtime);
+    return false;
+}
+
+bool ContentStore::ingest(const QString& path, const QByteArray& sha256, int mode) const {
+    Q_UNUSED(path);
+    Q_UNUSED(sha256);
+    Q_UNUSED(mode);
+    return false;
+}
+
+#endif // Q_OS_UNIX
+
+int ContentStore::prune(const QStringList& indexPaths) const {
+#ifdef Q_OS_UNIX
+    // Установки, которые сейчас связывают файлы с объектами, ещё не записали свои индексы:
+    // пока хоть одна держит разделяемую блокировку, удалять нельзя. Ожидание не нужно -
+    // очистка помечается отложенной, и её выполнит установка, которая закончится позже
+    const int lockFd = openLockFile();
+    if (lockFd < 0) {
+        return -1;
+    }
+    if (::flock(lockFd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(lockFd);
+        QFile pending(prunePendingPath());
+        pending.open(QIODevice::WriteOnly);
+        return -1;
+    }
+    // Блокировка снимается при закрытии дескриптора на выходе
+    struct LockGuard {
+        int fd;
+        ~LockGuard() { ::close(fd); }
+    } guard{lockFd};
+#endif
+    QFile::remove(prunePendingPath());
+
+    // Объекты, на которые ссылаются установленные пакеты. Индекс, который не читается
+    // (повреждён или старой версии), пропускается: его объекты сохраняются по числу ссылок ниже
+    QSet<QString> referenced;
+    bool allIndexesLoaded = true;
+    for (const QString& indexPath : indexPaths) {
+        InstalledIndex index;
+        if (!index.load(indexPath)) {
+            allIndexesLoaded = false;
+            continue;
+        }
+        const QHash<QString, InstalledFile>& files = index.files();
+        for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+            referenced.insert(objectName(it.value().sha256, it.value().mode));
+        }
+    }
+
+    int removed = 0;
+    for (QDirIterator it(m_rootPath, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories); it.hasNext();) {
+        const QString path = it.next();
+        if (!isObjectName(it.fileName()) || referenced.contains(it.fileName())) {
+            continue;
+        }
+        // Объект, связанный жёсткой ссылкой с какой-то установкой, может принадлежать пакету
+        // с нечитаемым индексом - без полного списка ссылок удаляются только ничьи объекты
+        if (!allIndexesLoaded && hasOtherLinks(path)) {
+            continue;
+        }
+        if (QFile::remove(path)) {
+            ++removed;
+        }
+    }
+    return removed;
+}
\ No newline at end of file
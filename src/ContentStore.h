@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+// Хранилище содержимого: файлы, ключ которых - SHA-256 содержимого и права доступа.
+// Одинаковые файлы разных пакетов и версий хранятся один раз, а установленные деревья
+// собираются из ссылок на объекты: reflink (копия при записи, своё время изменения),
+// если файловая система их поддерживает, иначе жёсткая ссылка (время изменения общее
+// с объектом, правка файла на месте затронет все его копии).
+// Хранилище лежит на той же файловой системе, что и корень установки. Методы потокобезопасны.
+//
+// Установка, которая берёт объекты из хранилища или добавляет их, держит разделяемую блокировку
+// (lockShared()), пока не сохранён её индекс: до этого её ссылки на объекты нигде не записаны.
+// prune() берёт исключительную блокировку и ничего не удаляет, пока хранилищем пользуется
+// кто-то ещё - в этом или другом процессе.
+class ContentStore {
+public:
+    explicit ContentStore(const QString& rootPath);
+    ~ContentStore();
+
+    ContentStore(const ContentStore&) = delete;
+    ContentStore& operator=(const ContentStore&) = delete;
+
+    // Папка хранилища для корня установки: <корень>/.packman/store
+    static QString defaultPathFor(const QString& installRoot);
+
+    QString rootPath() const { return m_rootPath; }
+    QString objectPath(const QByteArray& sha256, int mode) const;
+
+    // Создаёт файл path (полный путь) из объекта хранилища. false - объекта нет или ссылку
+    // создать не удалось; тогда файл нужно записать обычным образом.
+    // *actualMtime - время изменения получившегося файла
+    bool materialize(const QByteArray& sha256, int mode, qint64 mtime, const QString& path, qint64* actualMtime) const;
+    // Добавляет уже записанный файл в хранилище (если такого объекта ещё нет)
+    bool ingest(const QString& path, const QByteArray& sha256, int mode) const;
+    // Разделяемая блокировка хранилища этим объектом; снимается unlock() или в деструкторе
+    bool lockShared();
+    void unlock();
+
+    // Удаляет объекты, на которые не ссылается ни один из индексов установленных пакетов.
+    // Временные файлы не трогает. Нечитаемый индекс (повреждён или старой версии) не мешает
+    // очистке: пока такой есть, сохраняются все объекты, связанные с какой-либо установкой.
+    // Возвращает число удалённых объектов; -1 - хранилище занято другой установкой,
+    // и очистка отложена (см. isPrunePending())
+    int prune(const QStringList& indexPaths) const;
+    // Есть ли очистка, отложенная из-за того, что хранилище было занято
+    bool isPrunePending() const;
+
+private:
+    bool cloneFile(const QString& source, const QString& target) const;
+    int openLockFile() const;
+    QString prunePendingPath() const;
+
+    QString m_rootPath;
+    int m_lockFd = -1;
+    // Поддержка reflink выясняется при первой попытке: 0 - неизвестно, 1 - есть, -1 - нет
+    mutable std::atomic<int> m_reflinkState{0};
+};
\ No newline at end of file
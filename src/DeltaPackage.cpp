@@ -0,0 +1,419 @@
+#include "DeltaPackage.h"
+#include "ArchiveWriter.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr quint32 kPatchMagic = 0x504b4450; // "PKDP"
+constexpr quint8 kOpCopy = 1;
+constexpr quint8 kOpAdd = 2;
+// Размер блока, по которому ищутся совпадения с базовым файлом
+constexpr qint64 kBlockSize = 32;
+constexpr quint32 kHashBase = 257;
+// Патч, который почти не меньше файла, не нужен - файл кладётся целиком
+constexpr double kMaxPatchRatio = 0.8;
+constexpr qint64 kCopyChunk = 1024 * 1024;
+
+quint32 blockHash(const uchar* data) {
+    quint32 hash = 0;
+    for (qint64 i = 0; i < kBlockSize; ++i) {
+        hash = hash * kHashBase + data[i];
+    }
+    return hash;
+}
+
+void writeAdd(QDataStream& stream, const char* data, qint64 size) {
+    if (size > 0) {
+        stream << kOpAdd;
+        stream.writeBytes(data, static_cast<uint>(size));
+    }
+}
+
+int modeFromPermissions(QFileDevice::Permissions permissions) {
+    int mode = 0;
+    if (permissions & QFileDevice::ReadOwner) { mode |= 0400; }
+    if (permissions & QFileDevice::WriteOwner) { mode |= 0200; }
+    if (permissions & QFileDevice::ExeOwner) { mode |= 0100; }
+    if (permissions & QFileDevice::ReadGroup) { mode |= 0040; }
+    if (permissions & QFileDevice::WriteGroup) { mode |= 0020; }
+    if (permissions & QFileDevice::ExeGroup) { mode |= 0010; }
+    if (permissions & QFileDevice::ReadOther) { mode |= 0004; }
+    if (permissions & QFileDevice::WriteOther) { mode |= 0002; }
+    if (permissions & QFileDevice::ExeOther) { mode |= 0001; }
+    return mode;
+}
+
+// Цель ссылки как есть, без разрешения в абсолютный путь
+QString readSymlink(const QString& path) {
+#ifdef Q_OS_UNIX
+    QByteArray buffer(4096, Qt::Uninitialized);
+    const ssize_t length = ::readlink(QFile::encodeName(path).constData(), buffer.data(), static_cast<size_t>(buffer.size()));
+    return length < 0 ? QString() : QFile::decodeName(buffer.left(static_cast<int>(length)));
+#else
+    return QFileInfo(path).symLinkTarget();
+#endif
+}
+
+QString hexDigest(const QByteArray& digest) {
+    return QString::fromLatin1(digest.toHex());
+}
+
+QByteArray sha256(const char* data, qint64 size) {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (qint64 offset = 0; offset < size; offset += kCopyChunk) {
+        hash.addData(data + offset, static_cast<int>(qMin(kCopyChunk, size - offset)));
+    }
+    return hash.result();
+}
+
+// Файл, отображённый в память целиком (пустой файл - пустые данные)
+class MappedFile {
+public:
+    explicit MappedFile(const QString& path) : m_file(path) {}
+    bool open() {
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        if (m_file.size() == 0) {
+            return true;
+        }
+        m_data = m_file.map(0, m_file.size());
+        return m_data != nullptr;
+    }
+    const char* data() const { return reinterpret_cast<const char*>(m_data); }
+    qint64 size() const { return m_data ? m_file.size() : 0; }
+    QString errorString() const { return m_file.errorString(); }
+
+private:
+    QFile m_file;
+    uchar* m_data = nullptr;
+};
+
+// Что делать с очередным элементом новой версии
+struct DeltaItem {
+    enum class Kind { Directory, Symlink, File, Patch };
+    Kind kind;
+    QString path;
+    int mode = 0;
+    qint64 mtime = 0;
+    QString linkTarget;
+    QByteArray patch;
+};
+
+} // namespace
+
+bool DeltaManifest::parse(const QByteArray& json, DeltaManifest* manifest, QString* error) {
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &parseError);
+    if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+        *error = QString("Манифест дельта-пакета повреждён: %1").arg(parseError.errorString());
+        return false;
+    }
+    const QJsonObject root = document.object();
+    DeltaManifest parsed;
+    for (const QJsonValue& value : root.value("removed").toArray()) {
+        parsed.removed.insert(QDir::cleanPath(value.toString()));
+    }
+    const QJsonObject patches = root.value("patches").toObject();
+    for (auto it = patches.constBegin(); it != patches.constEnd(); ++it) {
+        const QJsonObject object = it.value().toObject();
+        Patch patch;
+        patch.baseSha256 = QByteArray::fromHex(object.value("base").toString().toLatin1());
+        patch.targetSha256 = QByteArray::fromHex(object.value("target").toString().toLatin1());
+        if (patch.baseSha256.size() != 32 || patch.targetSha256.size() != 32) {
+            *error = QString("Манифест дельта-пакета повреждён: неверные суммы для '%1'").arg(it.key());
+            return false;
+        }
+        parsed.patches.insert(QDir::cleanPath(it.key()), patch);
+    }
+    *manifest = parsed;
+    return true;
+}
+
+QByteArray DeltaManifest::toJson() const {
+    QStringList removedPaths = removed.values();
+    std::sort(removedPaths.begin(), removedPaths.end());
+    QJsonObject patchObject;
+    for (auto it = patches.constBegin(); it != patches.constEnd(); ++it) {
+        QJsonObject entry;
+        entry.insert("base", hexDigest(it.value().baseSha256));
+        entry.insert("target", hexDigest(it.value().targetSha256));
+        patchObject.insert(it.key(), entry);
+    }
+    QJsonObject root;
+    root.insert("version", 1);
+    root.insert("removed", QJsonArray::fromStringList(removedPaths));
+    root.insert("patches", patchObject);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray BinaryPatch::diff(const char* base, qint64 baseSize, const char* target, qint64 targetSize) {
+    const uchar* baseBytes = reinterpret_cast<const uchar*>(base);
+    const uchar* targetBytes = reinterpret_cast<const uchar*>(target);
+
+    // Первое вхождение каждого блока базового файла
+    QHash<quint32, qint64> blocks;
+    blocks.reserve(static_cast<int>(qMin<qint64>(baseSize / kBlockSize, 1 << 24)));
+    for (qint64 offset = 0; offset + kBlockSize <= baseSize; offset += kBlockSize) {
+        const quint32 hash = blockHash(baseBytes + offset);
+        if (!blocks.contains(hash)) {
+            blocks.insert(hash, offset);
+        }
+    }
+
+    quint32 topPower = 1;
+    for (qint64 i = 1; i < kBlockSize; ++i) {
+        topPower *= kHashBase;
+    }
+
+    QByteArray patch;
+    QDataStream stream(&patch, QIODevice::WriteOnly);
+    stream << kPatchMagic << quint64(targetSize);
+
+    qint64 literalStart = 0;
+    qint64 pos = 0;
+    quint32 hash = targetSize >= kBlockSize ? blockHash(targetBytes) : 0;
+    while (pos + kBlockSize <= targetSize) {
+        const auto it = blocks.constFind(hash);
+        if (it != blocks.constEnd() && std::memcmp(baseBytes + it.value(), targetBytes + pos, kBlockSize) == 0) {
+            // Расширяем совпадение назад (в ещё не записанные байты) и вперёд
+            qint64 baseStart = it.value();
+            qint64 targetStart = pos;
+            while (targetStart > literalStart && baseStart > 0 && baseBytes[baseStart - 1] == targetBytes[targetStart - 1]) {
+                --baseStart;
+                --targetStart;
+            }
+            qint64 length = pos - targetStart + kBlockSize;
+            while (baseStart + length < baseSize && targetStart + length < targetSize &&
+                   baseBytes[baseStart + length] == targetBytes[targetStart + length]) {
+                ++length;
+            }
+
+            writeAdd(stream, target + literalStart, targetStart - literalStart);
+            stream << kOpCopy << quint64(baseStart) << quint64(length);
+            pos = targetStart + length;
+            literalStart = pos;
+            if (pos + kBlockSize <= targetSize) {
+                hash = blockHash(targetBytes + pos);
+            }
+            continue;
+        }
+        // Сдвигаем окно хэша на байт
+        if (pos + kBlockSize < targetSize) {
+            hash = (hash - targetBytes[pos] * topPower) * kHashBase + targetBytes[pos + kBlockSize];
+        }
+        ++pos;
+    }
+    writeAdd(stream, target + literalStart, targetSize - literalStart);
+    return patch;
+}
+
+bool BinaryPatch::apply(const char* base, qint64 baseSize, const QByteArray& patch, QByteArray* result, QString* error,
+                        qint64 maxTargetSize) {
+    QDataStream stream(patch);
+    quint32 magic = 0;
+    quint64 targetSize = 0;
+    stream >> magic >> targetSize;
+    if (magic != kPatchMagic || targetSize > quint64(std::numeric_limits<int>::max())) {
+        *error = "Неверный формат патча";
+        return false;
+    }
+    if (maxTargetSize > 0 && targetSize > quint64(maxTargetSize)) {
+        *error = QString("файл после патча (%1 байт) больше допустимого для задания (%2 байт)").arg(targetSize).arg(maxTargetSize);
+        return false;
+    }
+
+    QByteArray output;
+    output.reserve(static_cast<int>(targetSize));
+    while (!stream.atEnd()) {
+        quint8 op = 0;
+        stream >> op;
+        if (op == kOpCopy) {
+            quint64 offset = 0;
+            quint64 length = 0;
+            stream >> offset >> length;
+            if (offset > quint64(baseSize) || length > quint64(baseSize) - offset ||
+                quint64(output.size()) + length > targetSize) {
+                *error = "Патч выходит за границы файла";
+                return false;
+            }
+            output.append(base + offset, static_cast<int>(length));
+        } else if (op == kOpAdd) {
+            QByteArray bytes;
+            stream >> bytes;
+            if (quint64(output.size()) + quint64(bytes.size()) > targetSize) {
+                *error = "Патч выходит за границы файла";
+                return false;
+            }
+            output.append(bytes);
+        } else {
+            *error = "Неизвестная операция в патче";
+            return false;
+        }
+        if (stream.status() != QDataStream::Ok) {
+            *error = "Патч обрезан";
+            return false;
+        }
+    }
+    if (quint64(output.size()) != targetSize) {
+        *error = "Размер результата патча не совпадает";
+        return false;
+    }
+    *result = output;
+    return true;
+}
+
+bool DeltaBuilder::build(const QString& baseDir, const QString& targetDir, const QString& outputPath,
+                         Stats* stats, QString* error) {
+    const QDir base(baseDir);
+    const QDir target(targetDir);
+    if (!base.exists() || !target.exists()) {
+        *error = QString("Папка '%1' или '%2' не найдена").arg(baseDir, targetDir);
+        return false;
+    }
+    const QDir::Filters filters = QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System;
+    Stats counts;
+
+    // 1. Сравнение версий: что положить в архив
+    QStringList targetPaths;
+    for (QDirIterator it(targetDir, filters, QDirIterator::Subdirectories); it.hasNext();) {
+        targetPaths.append(target.relativeFilePath(it.next()));
+    }
+    std::sort(targetPaths.begin(), targetPaths.end());
+
+    DeltaManifest manifest;
+    QList<DeltaItem> items;
+    for (const QString& path : qAsConst(targetPaths)) {
+        const QFileInfo info(target.filePath(path));
+        DeltaItem item;
+        item.path = path;
+        item.mode = modeFromPermissions(info.permissions());
+        item.mtime = info.lastModified().toSecsSinceEpoch();
+        if (info.isSymLink()) {
+            item.kind = DeltaItem::Kind::Symlink;
+            item.linkTarget = readSymlink(info.filePath());
+            items.append(item);
+            continue;
+        }
+        if (info.isDir()) {
+            item.kind = DeltaItem::Kind::Directory;
+            items.append(item);
+            continue;
+        }
+        if (!info.isFile()) {
+            continue;
+        }
+
+        item.kind = DeltaItem::Kind::File;
+        const QFileInfo baseInfo(base.filePath(path));
+        if (baseInfo.isFile() && !baseInfo.isSymLink()) {
+            MappedFile baseFile(baseInfo.filePath());
+            MappedFile targetFile(info.filePath());
+            if (!baseFile.open() || !targetFile.open()) {
+                *error = QString("Не удалось прочитать '%1': %2").arg(path, targetFile.errorString());
+                return false;
+            }
+            if (baseFile.size() == targetFile.size() && item.mode == modeFromPermissions(baseInfo.permissions()) &&
+                std::memcmp(baseFile.data(), targetFile.data(), static_cast<size_t>(targetFile.size())) == 0) {
+                ++counts.unchanged;
+                continue;
+            }
+            const QByteArray patch = BinaryPatch::diff(baseFile.data(), baseFile.size(), targetFile.data(), targetFile.size());
+            if (patch.size() < targetFile.size() * kMaxPatchRatio) {
+                item.kind = DeltaItem::Kind::Patch;
+                item.patch = patch;
+                DeltaManifest::Patch sums;
+                sums.baseSha256 = sha256(baseFile.data(), baseFile.size());
+                sums.targetSha256 = sha256(targetFile.data(), targetFile.size());
+                manifest.patches.insert(path, sums);
+                ++counts.patched;
+                items.append(item);
+                continue;
+            }
+        }
+        ++counts.added;
+        items.append(item);
+    }
+
+    // Файлы базовой версии, на месте которых в новой нет обычного файла
+    for (QDirIterator it(baseDir, filters, QDirIterator::Subdirectories); it.hasNext();) {
+        const QFileInfo info(it.next());
+        if (!info.isFile() || info.isSymLink()) {
+            continue;
+        }
+        const QString path = base.relativeFilePath(info.filePath());
+        const QFileInfo targetInfo(target.filePath(path));
+        if (!targetInfo.isFile() || targetInfo.isSymLink()) {
+            manifest.removed.insert(path);
+        }
+    }
+    counts.removed = manifest.removed.size();
+
+    // 2. Запись архива: манифест первым, чтобы распаковщик знал о патчах до их появления
+    QSaveFile output(outputPath);
+    if (!output.open(QIODevice::WriteOnly)) {
+        *error = QString("Не удалось создать '%1': %2").arg(outputPath, output.errorString());
+        return false;
+    }
+    GzipWriter gzip(&output);
+    TarWriter tar([&gzip](const char* data, qint64 size) { return gzip.write(data, size); });
+
+    bool ok = tar.addFile(DeltaManifest::entryName(), manifest.toJson());
+    for (const DeltaItem& item : qAsConst(items)) {
+        if (!ok) {
+            break;
+        }
+        switch (item.kind) {
+        case DeltaItem::Kind::Directory:
+            ok = tar.addDirectory(item.path, item.mode, item.mtime);
+            break;
+        case DeltaItem::Kind::Symlink:
+            ok = tar.addSymlink(item.path, item.linkTarget, item.mtime);
+            break;
+        case DeltaItem::Kind::Patch:
+            ok = tar.addFile(DeltaManifest::patchPrefix() + item.path, item.patch, item.mode, item.mtime);
+            break;
+        case DeltaItem::Kind::File: {
+            QFile file(target.filePath(item.path));
+            ok = file.open(QIODevice::ReadOnly) && tar.beginFile(item.path, file.size(), item.mode, item.mtime);
+            QByteArray chunk(static_cast<int>(kCopyChunk), Qt::Uninitialized);
+            while (ok && !file.atEnd()) {
+                const qint64 bytesRead = file.read(chunk.data(), chunk.size());
+                ok = bytesRead >= 0 && tar.writeData(chunk.constData(), bytesRead);
+            }
+            ok = ok && tar.endFile();
+            break;
+        }
+        }
+    }
+    ok = ok && tar.finish() && gzip.finish();
+    if (!ok || !output.commit()) {
+        *error = QString("Ошибка записи '%1': %2").arg(outputPath, gzip.errorString().isEmpty() ? output.errorString() : gzip.errorString());
+        return false;
+    }
+
+    counts.bytesWritten = tar.bytesWritten();
+    if (stats) {
+        *stats = counts;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+// Дельта-пакет - обычный tar (любого поддерживаемого сжатия) для обновления установленной
+// версии пакета. Первой записью идёт манифест ".packman-delta", затем все каталоги и ссылки
+// новой версии, новые и полностью заменённые файлы, а изменённые файлы - двоичными патчами
+// ".packman-patch/<путь>". Файлы, которых нет ни в манифесте, ни в архиве, не изменились
+// и берутся из установленной базовой версии.
+struct DeltaManifest {
+    struct Patch {
+        QByteArray baseSha256;   // Какой файл базовой версии ожидает патч
+        QByteArray targetSha256; // Что должно получиться
+    };
+
+    QSet<QString> removed;          // Файлы базовой версии, которых нет в новой
+    QHash<QString, Patch> patches;  // Путь -> суммы до и после патча
+
+    static QString entryName() { return QStringLiteral(".packman-delta"); }
+    static QString patchPrefix() { return QStringLiteral(".packman-patch/"); }
+
+    static bool parse(const QByteArray& json, DeltaManifest* manifest, QString* error);
+    QByteArray toJson() const;
+};
+
+// Двоичный патч: операции COPY (отрезок базового файла) и ADD (новые байты).
+// Совпадения ищутся по блокам базового файла с кольцевым хэшем, как в rsync
+class BinaryPatch {
+public:
+    static QByteArray diff(const char* base, qint64 baseSize, const char* target, qint64 targetSize);
+    // maxTargetSize - наибольший допустимый размер результата (он собирается в памяти целиком);
+    // 0 - без ограничения, кроме предела QByteArray
+    static bool apply(const char* base, qint64 baseSize, const QByteArray& patch, QByteArray* result, QString* error,
+                      qint64 maxTargetSize = 0);
+};
+
+// Сборка дельта-пакета (tar.gz) по двум распакованным версиям пакета
+class DeltaBuilder {
+public:
+    struct Stats {
+        int unchanged = 0;
+        int added = 0;    // Новые и заменённые целиком
+        int patched = 0;
+        int removed = 0;
+        qint64 bytesWritten = 0; // Размер несжатого tar
+    };
+
+    static bool build(const QString& baseDir, const QString& targetDir, const QString& outputPath,
+                      Stats* stats, QString* error);
+};
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "ExtractionJournal.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+
+constexpr quint32 kJournalMagic = 0x504b4a4e; // "PKJN"
+constexpr quint16 kJournalVersion = 2;
+// Сколько байт с начала и с конца архива входит в отпечаток
+constexpr qint64 kFingerprintSpan = 1024 * 1024;
+
+} // namespace
+
+QByteArray ExtractionJournal::fingerprint(const QString& archivePath, const QByteArray& archiveSha256) {
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(archiveSha256);
+    hash.addData(QByteArray::number(QFileInfo(archivePath).lastModified().toMSecsSinceEpoch()));
+    hash.addData(QByteArray::number(file.size()));
+    hash.addData(file.read(kFingerprintSpan));
+    if (file.size() > kFingerprintSpan && file.seek(qMax(kFingerprintSpan, file.size() - kFingerprintSpan))) {
+        hash.addData(file.readAll());
+    }
+    return hash.result();
+}
+
+bool ExtractionJournal::load(ExtractionCheckpoint* checkpoint) const {
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if (magic != kJournalMagic || version != kJournalVersion) {
+        return false;
+    }
+    ExtractionCheckpoint loaded;
+    stream >> loaded.archivePath >> loaded.archiveSize >> loaded.archiveFingerprint >> loaded.restartInput >> loaded.restartOutput
+           >> loaded.resumeOutput >> loaded.entries >> loaded.directoryModes >> loaded.verifiedEntries;
+    if (stream.status() != QDataStream::Ok || !loaded.isValid()) {
+        return false;
+    }
+    *checkpoint = loaded;
+    return true;
+}
+
+bool ExtractionJournal::save(const ExtractionCheckpoint& checkpoint, QString* error) const {
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << kJournalMagic << kJournalVersion
+           << checkpoint.archivePath << checkpoint.archiveSize << checkpoint.archiveFingerprint << checkpoint.restartInput << checkpoint.restartOutput
+           << checkpoint.resumeOutput << checkpoint.entries << checkpoint.directoryModes << checkpoint.verifiedEntries;
+    if (!file.commit()) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    return true;
+}
+
+void ExtractionJournal::remove() const {
+    QFile::remove(m_path);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+// Контрольная точка распаковки: с какого места можно продолжить прерванную установку.
+// Состояние декодера (zlib/zstd/xz) не сериализуется, поэтому хранится точка перезапуска -
+// начало члена сжатого потока (gzip/BGZF, кадр zstd, поток xz), с которого декодирование
+// начинается заново, - и смещение в tar, до которого записи уже на диске и пропускаются.
+struct ExtractionCheckpoint {
+    QString archivePath;        // Архив, к которому относится точка
+    qint64 archiveSize = 0;
+    QByteArray archiveFingerprint; // ExtractionJournal::fingerprint() этого архива
+    qint64 restartInput = 0;    // Смещение начала члена в сжатом архиве
+    qint64 restartOutput = 0;   // Смещение в tar, с которого начинается этот член
+    qint64 resumeOutput = 0;    // Заголовок tar после последней завершённой записи
+    qint64 entries = 0;         // Записей, завершённых до resumeOutput
+    QList<QPair<QString, int>> directoryModes; // Отложенные права каталогов до restartOutput
+    QStringList verifiedEntries; // Файлы, сумма которых уже проверена
+
+    bool isValid() const { return resumeOutput > 0; }
+};
+
+// Файл журнала рядом с промежуточной папкой установки. Запись атомарна (QSaveFile),
+// поэтому после аварийного завершения журнал содержит последнюю целую точку
+class ExtractionJournal {
+public:
+    explicit ExtractionJournal(const QString& path) : m_path(path) {}
+
+    QString path() const { return m_path; }
+
+    // Отпечаток архива: путь и размер не отличают пересобранный архив того же размера.
+    // SHA-256 от суммы архива из манифеста (если есть), времени изменения, первого и последнего мегабайта
+    static QByteArray fingerprint(const QString& archivePath, const QByteArray& archiveSha256);
+
+    bool load(ExtractionCheckpoint* checkpoint) const;
+    bool save(const ExtractionCheckpoint& checkpoint, QString* error = nullptr) const;
+    void remove() const;
+
+private:
+    QString m_path;
+};
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QRunnable>
+
+#include <functional>
+
+// QRunnable поверх произвольной функции - для запуска лямбд в QThreadPool
+class FunctionRunnable : public QRunnable {
+public:
+    explicit FunctionRunnable(std::function<void()> body) : m_body(std::move(body)) {}
+    void run() override { m_body(); }
+
+private:
+    std::function<void()> m_body;
+};
\ No newline at end of file
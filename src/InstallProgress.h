@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <QString>
+
+#include <atomic>
+
+// Этап конвейера установки
+enum class InstallPhase {
+    Queued,     // Ожидает свободного рабочего потока
+    Opening,    // Подключение бандла и открытие архива
+    Extracting, // Распаковка и запись файлов
+    Finalizing, // Дозапись файлов из очереди, права каталогов
+    Finished
+};
+
+// Счётчики, которые рабочий поток обновляет по ходу распаковки. Только атомарные
+// операции без сигналов: GUI сам опрашивает их с фиксированной частотой, поэтому
+// быстрый распаковщик не забивает очередь событий.
+struct InstallCounters {
+    std::atomic<int> phase{static_cast<int>(InstallPhase::Queued)};
+    std::atomic<qint64> bytesTotal{0};  // Размер сжатого архива
+    std::atomic<qint64> bytesIn{0};     // Прочитано сжатых байт
+    std::atomic<qint64> bytesOut{0};    // Распаковано байт
+    std::atomic<qint64> entries{0};     // Записано элементов архива
+
+    // Суммарное время по этапам, нс. decode и write суммируются по всем потокам,
+    // поэтому при конвейерной работе их сумма может превышать общее время
+    std::atomic<qint64> openNs{0};      // Подключение и открытие/отображение архива
+    std::atomic<qint64> decodeNs{0};    // Распаковка сжатых данных
+    std::atomic<qint64> writeNs{0};     // Создание каталогов, файлов и запись данных
+    std::atomic<qint64> finalizeNs{0};  // Дозапись очереди, права каталогов, перенос установки на место
+
+    // Запрос отмены: выставляется из GUI-потока, рабочий поток проверяет его между порциями
+    std::atomic<bool> cancelRequested{false};
+
+    void setPhase(InstallPhase value) { phase.store(static_cast<int>(value), std::memory_order_relaxed); }
+    void addIn(qint64 bytes) { bytesIn.fetch_add(bytes, std::memory_order_relaxed); }
+    void addOut(qint64 bytes) { bytesOut.fetch_add(bytes, std::memory_order_relaxed); }
+    void addEntry() { entries.fetch_add(1, std::memory_order_relaxed); }
+    bool isCancelled() const { return cancelRequested.load(std::memory_order_relaxed); }
+};
+
+// Добавляет время жизни объекта к счётчику этапа
+class PhaseTimer {
+public:
+    explicit PhaseTimer(std::atomic<qint64>& counter) : m_counter(counter) { m_timer.start(); }
+    ~PhaseTimer() { m_counter.fetch_add(m_timer.nsecsElapsed(), std::memory_order_relaxed); }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    std::atomic<qint64>& m_counter;
+    QElapsedTimer m_timer;
+};
+
+// Снимок прогресса установки, который PackageManager публикует раз в тик UI
+struct InstallProgress {
+    int jobId = 0;
+    QString packageName;
+    InstallPhase phase = InstallPhase::Queued;
+    qint64 bytesTotal = 0;
+    qint64 bytesIn = 0;
+    qint64 bytesOut = 0;
+    qint64 entries = 0;
+    double bytesPerSecond = 0.0; // Скорость чтения архива (сглаженная)
+    double etaSeconds = -1.0;    // Оценка оставшегося времени; < 0 - неизвестно
+    qint64 openNs = 0;
+    qint64 decodeNs = 0;
+    qint64 writeNs = 0;
+    qint64 finalizeNs = 0;
+
+    // Доля выполненной работы 0..1 по прочитанному архиву
+    double fraction() const { return bytesTotal > 0 ? double(bytesIn) / double(bytesTotal) : 0.0; }
+};
+
+Q_DECLARE_METATYPE(InstallProgress)
\ No newline at end of file
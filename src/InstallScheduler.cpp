@@ -0,0 +1,181 @@
+#include "InstallScheduler.h"
+#include "FunctionRunnable.h"
+
+#include <QThread>
+
+InstallScheduler::InstallScheduler(JobFunction function, QObject *parent)
+    : QObject(parent),
+      m_function(std::move(function)),
+      m_maxConcurrentJobs(qMax(1, QThread::idealThreadCount())) {
+    m_pool.setMaxThreadCount(m_maxConcurrentJobs);
+}
+
+InstallScheduler::~InstallScheduler() {
+    // Закрытие окна не ждёт окончания установок: ожидающие задания снимаются, выполняющимся
+    // передаётся запрос отмены, и они откатываются. Без сигналов - получатели уже разрушаются
+    for (const InstallJob& job : qAsConst(m_jobs)) {
+        if (job.state == InstallJob::State::Running) {
+            job.counters->cancelRequested.store(true);
+        }
+    }
+    m_jobs.clear();
+    // Рабочие потоки обращаются к m_function, поэтому дожидаемся их до разрушения.
+    // Отложенные уведомления для удалённого объекта Qt просто отбросит
+    m_pool.waitForDone();
+}
+
+int InstallScheduler::enqueue(InstallJob job) {
+    job.id = m_nextJobId++;
+    job.state = InstallJob::State::Queued;
+    job.counters = std::make_shared<InstallCounters>();
+    m_jobs.append(job);
+    dispatch();
+    return job.id;
+}
+
+bool InstallScheduler::cancel(int jobId) {
+    InstallJob* job = findJob(jobId);
+    if (!job) {
+        return false;
+    }
+    if (job->state == InstallJob::State::Running) {
+        job->counters->cancelRequested.store(true);
+        return true;
+    }
+    if (job->state != InstallJob::State::Queued) {
+        return false;
+    }
+
+    const QString packageName = job->package.displayName;
+    const QString message = QString("Установка '%1' отменена").arg(packageName);
+    removeJob(jobId);
+    emit jobCancelled(jobId, packageName, message);
+    if (!isBusy()) {
+        emit allJobsFinished();
+    }
+    return true;
+}
+
+void InstallScheduler::cancelAll() {
+    // Сначала ожидающие, чтобы освободившиеся потоки не успели взять их в работу
+    QList<int> running;
+    QList<int> queued;
+    for (const InstallJob& job : qAsConst(m_jobs)) {
+        if (job.state == InstallJob::State::Queued) {
+            queued.append(job.id);
+        } else if (job.state == InstallJob::State::Running) {
+            running.append(job.id);
+        }
+    }
+    for (int jobId : qAsConst(queued)) {
+        cancel(jobId);
+    }
+    for (int jobId : qAsConst(running)) {
+        cancel(jobId);
+    }
+}
+
+void InstallScheduler::setMaxConcurrentJobs(int count) {
+    m_maxConcurrentJobs = qMax(1, count);
+    m_pool.setMaxThreadCount(m_maxConcurrentJobs);
+    dispatch();
+}
+
+QList<InstallJob> InstallScheduler::runningJobs() const {
+    QList<InstallJob> running;
+    for (const InstallJob& job : m_jobs) {
+        if (job.state == InstallJob::State::Running) {
+            running.append(job);
+        }
+    }
+    return running;
+}
+
+bool InstallScheduler::isPending(const QString& packageId) const {
+    for (const InstallJob& job : m_jobs) {
+        if (job.package.id == packageId &&
+            (job.state == InstallJob::State::Queued || job.state == InstallJob::State::Running)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InstallScheduler::isBusy() const {
+    if (m_runningJobs > 0) {
+        return true;
+    }
+    for (const InstallJob& job : m_jobs) {
+        if (job.state == InstallJob::State::Queued) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void InstallScheduler::dispatch() {
+    for (InstallJob& job : m_jobs) {
+        if (m_runningJobs >= m_maxConcurrentJobs) {
+            break;
+        }
+        if (job.state != InstallJob::State::Queued) {
+            continue;
+        }
+
+        job.state = InstallJob::State::Running;
+        ++m_runningJobs;
+        emit jobStarted(job.id, job.package.displayName);
+
+        const InstallJob snapshot = job;
+        m_pool.start(new FunctionRunnable([this, snapshot]() {
+            QString message;
+            const bool ok = m_function(snapshot, &message);
+            const int jobId = snapshot.id;
+            QMetaObject::invokeMethod(this, [this, jobId, ok, message]() {
+                onJobDone(jobId, ok, message);
+            }, Qt::QueuedConnection);
+        }));
+    }
+}
+
+void InstallScheduler::onJobDone(int jobId, bool success, const QString& message) {
+    InstallJob* job = findJob(jobId);
+    if (!job) {
+        return;
+    }
+    if (success) {
+        job->state = InstallJob::State::Succeeded;
+    } else {
+        job->state = job->counters->isCancelled() ? InstallJob::State::Cancelled : InstallJob::State::Failed;
+    }
+    job->message = message;
+    --m_runningJobs;
+
+    const QString packageName = job->package.displayName;
+    // Обработчики ещё видят задание в jobs() - например, для финального снимка прогресса
+    emit jobFinished(jobId, packageName, success, message);
+    removeJob(jobId);
+
+    dispatch();
+    if (!isBusy()) {
+        emit allJobsFinished();
+    }
+}
+
+void InstallScheduler::removeJob(int jobId) {
+    for (int i = 0; i < m_jobs.size(); ++i) {
+        if (m_jobs.at(i).id == jobId) {
+            m_jobs.removeAt(i);
+            return;
+        }
+    }
+}
+
+InstallJob* InstallScheduler::findJob(int jobId) {
+    for (InstallJob& job : m_jobs) {
+        if (job.id == jobId) {
+            return &job;
+        }
+    }
+    return nullptr;
+}
\ No newline at end of file
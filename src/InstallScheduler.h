@@ -0,0 +1,84 @@
+#pragma once
+
+#include "PackageInfo.h"
+#include "InstallProgress.h"
+
+#include <QObject>
+#include <QList>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <functional>
+#include <memory>
+
+// Задание установки в очереди планировщика
+struct InstallJob {
+    enum class State { Queued, Running, Succeeded, Failed, Cancelled };
+
+    int id = 0;
+    PackageInfo package;
+    QString targetPath; // Папка установки, зафиксированная при постановке в очередь
+    QString basePath;   // Для дельта-пакета - папка обновляемой установленной версии
+    QString storePath;  // Хранилище содержимого (ContentStore); пусто - не используется
+    QStringList paths;  // Частичная установка: только эти пути архива; пусто - весь пакет
+    qint64 memoryBudget = 0; // Память конвейера распаковки этого задания (ArchiveExtractor::setMemoryBudget)
+    int threadCount = 0;     // Потоки распаковки и записи этого задания (ArchiveExtractor::setThreadCounts); 0 - по числу ядер
+    State state = State::Queued;
+    QString message; // Итоговое сообщение после завершения
+    std::shared_ptr<InstallCounters> counters; // Прогресс, обновляемый рабочим потоком
+};
+
+// Планировщик установок: очередь заданий, выполняемых пулом рабочих потоков вне GUI-потока.
+// Задания запускаются строго в порядке постановки, одновременно выполняется не больше
+// maxConcurrentJobs(). Все сигналы испускаются в потоке, которому принадлежит планировщик.
+// Завершённое задание удаляется из очереди сразу после jobFinished() / jobCancelled().
+class InstallScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    // Функция установки; вызывается в рабочем потоке. true - успех, текст результата в *message
+    using JobFunction = std::function<bool(const InstallJob& job, QString* message)>;
+
+    explicit InstallScheduler(JobFunction function, QObject *parent = nullptr);
+    // Отменяет все задания (без сигналов) и ждёт только отката выполняющихся
+    ~InstallScheduler() override;
+
+    // Ставит задание в очередь (id, состояние и счётчики назначаются здесь) и возвращает его идентификатор
+    int enqueue(InstallJob job);
+
+    // Отмена задания: ожидающее снимается сразу с jobCancelled() (jobStarted() для него не было),
+    // выполняющемуся передаётся запрос отмены, и оно завершается с jobFinished(success = false)
+    // после отката. false - задание уже завершено
+    bool cancel(int jobId);
+    void cancelAll();
+
+    void setMaxConcurrentJobs(int count);
+    int maxConcurrentJobs() const { return m_maxConcurrentJobs; }
+
+    QList<InstallJob> jobs() const { return m_jobs; }
+    QList<InstallJob> runningJobs() const;
+    // Есть ли задания в очереди или в работе для пакета с данным id
+    bool isPending(const QString& packageId) const;
+    bool isBusy() const;
+
+signals:
+    void jobStarted(int jobId, const QString& packageName);
+    void jobFinished(int jobId, const QString& packageName, bool success, const QString& message);
+    // Задание снято с очереди, не начав выполняться
+    void jobCancelled(int jobId, const QString& packageName, const QString& message);
+    // Очередь опустела и ни одно задание не выполняется
+    void allJobsFinished();
+
+private:
+    void dispatch();
+    void onJobDone(int jobId, bool success, const QString& message);
+    InstallJob* findJob(int jobId);
+    void removeJob(int jobId);
+
+    JobFunction m_function;
+    QThreadPool m_pool;
+    QList<InstallJob> m_jobs; // В порядке постановки в очередь
+    int m_maxConcurrentJobs;
+    int m_runningJobs = 0;
+    int m_nextJobId = 1;
+};
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "InstalledIndex.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+constexpr quint32 kIndexMagic = 0x504b494e; // "PKIN"
+// Версия 2: индекс полный - в нём и файлы, записанные до контрольной точки, и жёсткие ссылки.
+// Индексы версии 1 могли их не содержать и не используются
+constexpr quint16 kIndexVersion = 2;
+
+// Права файла в том же виде, что в заголовке tar
+int fileMode(const QFileInfo& info) {
+#ifdef Q_OS_UNIX
+    struct stat status;
+    if (::lstat(QFile::encodeName(info.filePath()).constData(), &status) == 0) {
+        return static_cast<int>(status.st_mode & 07777);
+    }
+    return 0;
+#else
+    const QFileDevice::Permissions permissions = info.permissions();
+    int mode = 0;
+    if (permissions & QFileDevice::ReadOwner) { mode |= 0400; }
+    if (permissions & QFileDevice::WriteOwner) { mode |= 0200; }
+    if (permissions & QFileDevice::ExeOwner) { mode |= 0100; }
+    if (permissions & QFileDevice::ReadGroup) { mode |= 0040; }
+    if (permissions & QFileDevice::WriteGroup) { mode |= 0020; }
+    if (permissions & QFileDevice::ExeGroup) { mode |= 0010; }
+    if (permissions & QFileDevice::ReadOther) { mode |= 0004; }
+    if (permissions & QFileDevice::WriteOther) { mode |= 0002; }
+    if (permissions & QFileDevice::ExeOther) { mode |= 0001; }
+    return mode;
+#endif
+}
+
+} // namespace
+
+QString InstalledIndex::pathFor(const QString& installRoot, const QString& packageId) {
+    return QDir(installRoot).filePath(QString(".packman/%1.index").arg(packageId));
+}
+
+bool InstalledIndex::load(const QString& path, QString* error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != kIndexMagic || version != kIndexVersion) {
+        if (error) { *error = QString("Индекс '%1' устарел или повреждён").arg(path); }
+        return false;
+    }
+
+    QHash<QString, InstalledFile> files;
+    files.reserve(static_cast<int>(qMin<quint32>(count, 1u << 20)));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString filePath;
+        InstalledFile entry;
+        qint32 mode = 0;
+        stream >> filePath >> entry.size >> entry.mtime >> mode >> entry.sha256;
+        entry.mode = mode;
+        files.insert(filePath, entry);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        if (error) { *error = QString("Индекс '%1' повреждён").arg(path); }
+        return false;
+    }
+    m_files.swap(files);
+    return true;
+}
+
+bool InstalledIndex::save(const QString& path, QString* error) const {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << kIndexMagic << kIndexVersion << quint32(m_files.size());
+    for (auto it = m_files.constBegin(); it != m_files.constEnd(); ++it) {
+        stream << it.key() << it.value().size << it.value().mtime << qint32(it.value().mode) << it.value().sha256;
+    }
+    if (!file.commit()) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    return true;
+}
+
+bool InstalledIndex::addMissingFiles(const QString& rootDir, QString* error) {
+    const QDir root(rootDir);
+    const QDir::Filters filters = QDir::Files | QDir::Hidden | QDir::System | QDir::NoSymLinks;
+    for (QDirIterator it(rootDir, filters, QDirIterator::Subdirectories); it.hasNext();) {
+        const QString absolutePath = it.next();
+        const QString path = root.relativeFilePath(absolutePath);
+        if (m_files.contains(path)) {
+            continue;
+        }
+        QFile file(absolutePath);
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        if (!file.open(QIODevice::ReadOnly) || !hash.addData(&file)) {
+            if (error) { *error = QString("Не удалось прочитать '%1': %2").arg(absolutePath, file.errorString()); }
+            return false;
+        }
+        const QFileInfo info = it.fileInfo();
+        InstalledFile entry;
+        entry.size = info.size();
+        entry.mtime = info.lastModified().toSecsSinceEpoch();
+        entry.mode = fileMode(info);
+        entry.sha256 = hash.result();
+        m_files.insert(path, entry);
+    }
+    return true;
+}
+
+const InstalledFile* InstalledIndex::find(const QString& path) const {
+    const auto it = m_files.constFind(path);
+    return it == m_files.constEnd() ? nullptr : &it.value();
+}
\ No newline at end of file
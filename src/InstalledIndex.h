@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+// Сведения об установленном файле
+struct InstalledFile {
+    qint64 size = 0;
+    qint64 mtime = 0;   // Время изменения, секунды Unix (как в заголовке tar)
+    int mode = 0;
+    QByteArray sha256;
+};
+
+// Индекс файлов установленного пакета: путь относительно папки пакета -> размер, время,
+// права и SHA-256 содержимого. По нему переустановка и восстановление пропускают
+// неизменившиеся файлы вместо повторной записи.
+class InstalledIndex {
+public:
+    // Файл индекса пакета: <корень установки>/.packman/<id>.index
+    static QString pathFor(const QString& installRoot, const QString& packageId);
+
+    bool load(const QString& path, QString* error = nullptr);
+    bool save(const QString& path, QString* error = nullptr) const;
+
+    // Дополняет индекс обычными файлами дерева rootDir, которых в нём ещё нет, - с хэшированием
+    // содержимого. Так индекс становится полным, даже если распаковка учла не все файлы
+    bool addMissingFiles(const QString& rootDir, QString* error = nullptr);
+
+    const InstalledFile* find(const QString& path) const;
+    void insert(const QString& path, const InstalledFile& file) { m_files.insert(path, file); }
+    const QHash<QString, InstalledFile>& files() const { return m_files; }
+    int size() const { return m_files.size(); }
+    bool isEmpty() const { return m_files.isEmpty(); }
+
+private:
+    QHash<QString, InstalledFile> m_files;
+};
\ No newline at end of file
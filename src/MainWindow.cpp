@@ -1,7 +1,11 @@
 #include "MainWindow.h"
+#include "Trace.h"
 #include <QMessageBox>
 #include <QDebug>
 #include <QSpacerItem>
+#include <QShortcut>
+#include <QDateTime>
+#include <QDir>
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     packageManager = new PackageManager(this);
@@ -104,6 +108,22 @@ void MainWindow::setupPagePackageSelect() {
     statusLabel = new QLabel("Статус: Ожидание выбора...", pagePacketSelect);
     statusLabel->setWordWrap(true);
     pageLayout->addWidget(statusLabel);
+
+    // Индикатор прогресса установки: скорость и оставшееся время
+    progressBar = new QProgressBar(pagePacketSelect);
+    progressBar->setRange(0, 1000);
+    progressBar->setTextVisible(true);
+    progressBar->setVisible(false);
+    pageLayout->addWidget(progressBar);
+
+    progressLabel = new QLabel(pagePacketSelect);
+    progressLabel->setVisible(false);
+    pageLayout->addWidget(progressLabel);
+
+    // Отмена установки: распакованное к этому моменту удаляется, целевая папка не меняется
+    cancelButton = new QPushButton("Отменить установку", pagePacketSelect);
+    cancelButton->setVisible(false);
+    pageLayout->addWidget(cancelButton, 0, Qt::AlignLeft);
     
     pageLayout->addStretch(1); // Чтобы элементы не растягивались на всю высоту
 
@@ -112,18 +132,18 @@ void MainWindow::setupPagePackageSelect() {
 }
 
 void MainWindow::loadPackagesToComboBox() {
-    packageComboBox->clear();
-    QList<PackageInfo> packages = packageManager->getAvailablePackages();
-    if (packages.isEmpty()) {
+    const PackageCatalog& catalog = packageManager->catalog();
+    if (catalog.isEmpty()) {
+        packageComboBox->clear();
         packageComboBox->addItem("Нет доступных пакетов");
         packageComboBox->setEnabled(false);
         qDebug() << "Список пакетов пуст.";
     } else {
-        for (const PackageInfo& pkg : packages) {
-            packageComboBox->addItem(pkg.displayName, QVariant::fromValue(pkg.id)); // Сохраняем ID пакета
-        }
+        // Модель отдаёт строки порциями, поэтому размер каталога не влияет на отзывчивость
+        packageListModel = new PackageListModel(&catalog, this);
+        packageComboBox->setModel(packageListModel);
         packageComboBox->setEnabled(true);
-        qDebug() << "Загружено пакетов в ComboBox:" << packages.size();
+        qDebug() << "Загружено пакетов в ComboBox:" << catalog.size();
     }
 }
 
@@ -136,11 +156,46 @@ void MainWindow::connectSignalsAndSlots() {
     // Подключение к сигналам PackageManager
     connect(packageManager, &PackageManager::installationStarted, this, [this](const QString& packageName){
         statusLabel->setText(QString("Началась установка %1...").arg(packageName));
+        progressBar->setValue(0);
+        progressBar->setVisible(true);
+        progressLabel->clear();
+        progressLabel->setVisible(true);
+        cancelButton->setEnabled(true);
+        cancelButton->setVisible(true);
         nextButton->setEnabled(false); // Блокируем кнопку "Установить" во время установки
         backButton->setEnabled(false); // И кнопку "Назад"
     });
+    connect(cancelButton, &QPushButton::clicked, this, [this]() {
+        cancelButton->setEnabled(false);
+        statusLabel->setText("Отмена установки...");
+        packageManager->cancelAllInstallations();
+    });
     connect(packageManager, &PackageManager::installationFinished, this, &MainWindow::handleInstallationStatus);
+    connect(packageManager, &PackageManager::installationCancelled, this, &MainWindow::handleInstallationCancelled);
     connect(packageManager, &PackageManager::statusMessage, this, &MainWindow::displayStatusMessage);
+    connect(packageManager, &PackageManager::progressChanged, this, &MainWindow::displayProgress);
+
+    // Ctrl+Shift+T: включить трассировку, повторно - выключить и сохранить её в домашнюю папку
+    QShortcut* traceShortcut = new QShortcut(QKeySequence("Ctrl+Shift+T"), this);
+    connect(traceShortcut, &QShortcut::activated, this, &MainWindow::toggleTracing);
+}
+
+void MainWindow::toggleTracing() {
+    if (!Trace::isEnabled()) {
+        Trace::clear();
+        Trace::setEnabled(true);
+        displayStatusMessage("Трассировка включена");
+        return;
+    }
+    Trace::setEnabled(false);
+    const QString path = QDir::home().filePath(QString("packman-trace-%1.json")
+                                                   .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")));
+    QString error;
+    if (Trace::writeChromeJson(path, &error)) {
+        displayStatusMessage(QString("Трассировка сохранена в '%1'").arg(path));
+    } else {
+        displayStatusMessage(QString("Не удалось сохранить трассировку: %1").arg(error));
+    }
 }
 
 void MainWindow::handleNextButton() {
@@ -160,22 +215,13 @@ void MainWindow::handleNextButton() {
             QMessageBox::warning(this, "Ошибка", "Пожалуйста, выберите пакет для установки.");
             return;
         }
-        QString selectedPackageId = packageComboBox->currentData().toString();
-        QList<PackageInfo> packages = packageManager->getAvailablePackages();
-        PackageInfo packageToInstall;
-        bool found = false;
-        for(const auto& pkg : packages) {
-            if (pkg.id == selectedPackageId) {
-                packageToInstall = pkg;
-                found = true;
-                break;
-            }
-        }
+        QString selectedPackageId = packageComboBox->currentData(PackageListModel::PackageIdRole).toString();
+        const PackageInfo* packageToInstall = packageManager->findPackage(selectedPackageId);
 
-        if (found) {
-            qDebug() << "Запрос на установку пакета:" << packageToInstall.displayName;
-            statusLabel->setText(QString("Подготовка к установке %1...").arg(packageToInstall.displayName));
-            packageManager->installPackage(packageToInstall);
+        if (packageToInstall) {
+            qDebug() << "Запрос на установку пакета:" << packageToInstall->displayName;
+            statusLabel->setText(QString("Подготовка к установке %1...").arg(packageToInstall->displayName));
+            packageManager->installPackage(*packageToInstall);
         } else {
              QMessageBox::critical(this, "Ошибка", "Выбранный пакет не найден.");
              statusLabel->setText("Ошибка: Выбранный пакет не найден.");
@@ -214,6 +260,22 @@ void MainWindow::handleInstallationStatus(const QString& packageName, bool succe
     } else {
         QMessageBox::critical(this, "Ошибка установки", message);
     }
+    unlockControlsIfIdle();
+}
+
+void MainWindow::handleInstallationCancelled(const QString& packageName, const QString& message) {
+    Q_UNUSED(packageName);
+    // Установка снята с очереди до начала: сообщать об ошибке не о чем
+    statusLabel->setText(message);
+    unlockControlsIfIdle();
+}
+
+void MainWindow::unlockControlsIfIdle() {
+    // Пока в очереди есть другие задания, кнопки остаются заблокированными
+    if (packageManager->isBusy()) {
+        return;
+    }
+    cancelButton->setVisible(false);
     // Разблокируем кнопки после завершения установки (успешной или нет)
     nextButton->setEnabled(true);
     backButton->setEnabled(true);
@@ -225,4 +287,25 @@ void MainWindow::displayStatusMessage(const QString& message) {
     // или в отдельный QTextEdit для логов, если потребуется.
     // Пока просто выводим в qDebug и, возможно, обновляем statusLabel, если это не сообщение о финальном результате.
     qDebug() << "PackageManager Status:" << message;
+}
+
+void MainWindow::displayProgress(const InstallProgress& progress) {
+    const double megabyte = 1024.0 * 1024.0;
+    progressBar->setValue(static_cast<int>(progress.fraction() * progressBar->maximum()));
+    progressBar->setFormat(QString("%1: %p%").arg(progress.packageName));
+
+    QString text = QString("%1 из %2 МБ, распаковано %3 МБ, файлов: %4")
+                       .arg(progress.bytesIn / megabyte, 0, 'f', 1)
+                       .arg(progress.bytesTotal / megabyte, 0, 'f', 1)
+                       .arg(progress.bytesOut / megabyte, 0, 'f', 1)
+                       .arg(progress.entries);
+    if (progress.phase == InstallPhase::Finalizing) {
+        text += ", завершение записи...";
+    } else if (progress.phase == InstallPhase::Extracting && progress.bytesPerSecond > 0.0) {
+        text += QString(", %1 МБ/с").arg(progress.bytesPerSecond / megabyte, 0, 'f', 1);
+        if (progress.etaSeconds >= 0.0) {
+            text += QString(", осталось ~%1 с").arg(qRound(progress.etaSeconds));
+        }
+    }
+    progressLabel->setText(text);
 }
\ No newline at end of file
@@ -11,10 +11,12 @@
 #include <QLineEdit>
 #include <QComboBox>
 #include <QLabel>
+#include <QProgressBar>
 
 
 #include "PackageManager.h"
 #include "PackageInfo.h"
+#include "PackageListModel.h"
 
 
 class MainWindow : public QMainWindow
@@ -30,13 +32,19 @@ private slots:
     void handleBackButton();
     void updateButtonStates(int pageIndex);
     void handleInstallationStatus(const QString& packageName, bool success, const QString& message);
+    void handleInstallationCancelled(const QString& packageName, const QString& message);
     void displayStatusMessage(const QString& message);
+    void displayProgress(const InstallProgress& progress);
+    void toggleTracing();
 
 private:
     //UI элементы для страниц
     QLineEdit* surnameInput;
     QComboBox* packageComboBox;
     QLabel* statusLabel;
+    QProgressBar* progressBar;
+    QLabel* progressLabel;
+    QPushButton* cancelButton;
 
     //Основные UI элементы окна
     QPushButton* backButton;
@@ -52,6 +60,7 @@ private:
     //Переменные для хранения данных
     QString currentSurname;
     PackageManager* packageManager;
+    PackageListModel* packageListModel = nullptr;
 
     void setupUI();
     void createPages();
@@ -59,5 +68,6 @@ private:
     void setupPagePackageSelect();
     void connectSignalsAndSlots();
     void loadPackagesToComboBox();
+    void unlockControlsIfIdle();
 };
 #endif // MAINWINDOW_H
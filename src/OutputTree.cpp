@@ -0,0 +1,520 @@
+#include "OutputTree.h"
+
+#include <QDir>
+#include <QMutexLocker>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <QDateTime>
+#include <QFileInfo>
+#endif
+
+namespace {
+
+// Порции записи меньше этого размера копятся в буфере
+constexpr int kCoalesceSize = 1024 * 1024;
+// Место под файлы не меньше этого размера резервируется заранее
+constexpr qint64 kPreallocateThreshold = 64 * 1024;
+// Сколько дескрипторов каталогов держать открытыми; остальные открываются временно
+constexpr int kMaxCachedDirectories = 1024;
+
+QString parentOf(const QString& path) {
+    const int slash = path.lastIndexOf('/');
+    return slash < 0 ? QString("") : path.left(slash);
+}
+
+QString nameOf(const QString& path) {
+    return path.mid(path.lastIndexOf('/') + 1);
+}
+
+#ifdef Q_OS_UNIX
+QString systemError(const QString& what, const QString& path) {
+    return QString("%1 '%2': %3").arg(what, path, QString::fromLocal8Bit(std::strerror(errno)));
+}
+
+bool writeAll(int fd, const char* data, qint64 size) {
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, static_cast<size_t>(size));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+void preallocate(int fd, qint64 size) {
+#ifdef Q_OS_LINUX
+    // fallocate, а не posix_fallocate: без поддержки в ФС последняя эмулирует резерв записью нулей
+    if (size >= kPreallocateThreshold) {
+        ::fallocate(fd, 0, 0, static_cast<off_t>(size));
+    }
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(size);
+#endif
+}
+
+bool finishFile(int fd, int mode, qint64 mtime) {
+    bool ok = ::fchmod(fd, static_cast<mode_t>(mode)) == 0;
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = static_cast<time_t>(mtime);
+    times[1].tv_nsec = 0;
+    ok = ::futimens(fd, times) == 0 && ok;
+    return ::close(fd) == 0 && ok;
+}
+#else
+QFileDevice::Permissions permissionsFromMode(int mode) {
+    QFileDevice::Permissions permissions;
+    if (mode & 0400) { permissions |= QFileDevice::ReadOwner | QFileDevice::ReadUser; }
+    if (mode & 0200) { permissions |= QFileDevice::WriteOwner | QFileDevice::WriteUser; }
+    if (mode & 0100) { permissions |= QFileDevice::ExeOwner | QFileDevice::ExeUser; }
+    if (mode & 0040) { permissions |= QFileDevice::ReadGroup; }
+    if (mode & 0020) { permissions |= QFileDevice::WriteGroup; }
+    if (mode & 0010) { permissions |= QFileDevice::ExeGroup; }
+    if (mode & 0004) { permissions |= QFileDevice::ReadOther; }
+    if (mode & 0002) { permissions |= QFileDevice::WriteOther; }
+    if (mode & 0001) { permissions |= QFileDevice::ExeOther; }
+    return permissions;
+}
+#endif
+
+} // namespace
+
+OutputTree::OutputTree(const QString& rootPath) : m_rootPath(QDir::cleanPath(rootPath)) {}
+
+OutputTree::~OutputTree() {
+#ifdef Q_OS_UNIX
+    for (int fd : qAsConst(m_dirCache)) {
+        ::close(fd);
+    }
+    if (m_rootFd >= 0) {
+        ::close(m_rootFd);
+    }
+#endif
+}
+
+QString OutputTree::absolutePath(const QString& path) const {
+    return path.isEmpty() ? m_rootPath : m_rootPath + '/' + path;
+}
+
+#ifdef Q_OS_UNIX
+
+OutputTree::DirHandle::~DirHandle() {
+    if (owned && fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool OutputTree::open(QString* error) {
+    if (!QDir().mkpath(m_rootPath)) {
+        *error = QString("Не удалось создать папку '%1'").arg(m_rootPath);
+        return false;
+    }
+    m_rootFd = ::open(QFile::encodeName(m_rootPath).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (m_rootFd < 0) {
+        *error = systemError("Не удалось открыть папку", m_rootPath);
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::openDirectory(const QString& path, DirHandle* dir, QString* error) {
+    if (path.isEmpty()) {
+        dir->fd = m_rootFd;
+        dir->owned = false;
+        return true;
+    }
+    {
+        QMutexLocker lock(&m_cacheMutex);
+        const auto it = m_dirCache.constFind(path);
+        if (it != m_dirCache.constEnd()) {
+            dir->fd = it.value();
+            dir->owned = false;
+            return true;
+        }
+    }
+
+    DirHandle parent;
+    if (!openDirectory(parentOf(path), &parent, error)) {
+        return false;
+    }
+    const QByteArray name = QFile::encodeName(nameOf(path));
+    if (::mkdirat(parent.fd, name.constData(), 0755) != 0 && errno != EEXIST) {
+        *error = systemError("Не удалось создать папку", absolutePath(path));
+        return false;
+    }
+    int fd = ::openat(parent.fd, name.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0 && (errno == ENOTDIR || errno == ELOOP)) {
+        // На месте каталога файл или ссылка из предыдущей установки - заменяем
+        ::unlinkat(parent.fd, name.constData(), 0);
+        if (::mkdirat(parent.fd, name.constData(), 0755) == 0 || errno == EEXIST) {
+            fd = ::openat(parent.fd, name.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        }
+    }
+    if (fd < 0) {
+        *error = systemError("Не удалось открыть папку", absolutePath(path));
+        return false;
+    }
+
+    QMutexLocker lock(&m_cacheMutex);
+    const auto it = m_dirCache.constFind(path);
+    if (it != m_dirCache.constEnd()) {
+        // Другой поток успел открыть тот же каталог
+        ::close(fd);
+        dir->fd = it.value();
+        dir->owned = false;
+    } else if (m_dirCache.size() < kMaxCachedDirectories) {
+        m_dirCache.insert(path, fd);
+        dir->fd = fd;
+        dir->owned = false;
+    } else {
+        dir->fd = fd;
+        dir->owned = true;
+    }
+    return true;
+}
+
+bool OutputTree::openParent(const QString& path, DirHandle* dir, QByteArray* name, QString* error) {
+    *name = QFile::encodeName(nameOf(path));
+    return openDirectory(parentOf(path), dir, error);
+}
+
+int OutputTree::openFileAt(int dirFd, const QByteArray& name, const QString& path, QString* error) {
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC;
+    // Файл, оставшийся от прерванной попытки, может быть жёсткой ссылкой на прежнюю установку
+    // или объект хранилища: O_TRUNC испортил бы общий inode, поэтому такой файл заменяется новым
+    struct stat existing;
+    if (::fstatat(dirFd, name.constData(), &existing, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(existing.st_mode) &&
+        existing.st_nlink > 1) {
+        ::unlinkat(dirFd, name.constData(), 0);
+    }
+    int fd = ::openat(dirFd, name.constData(), flags, 0600);
+    if (fd < 0 && errno == ELOOP) {
+        // Ссылка на месте файла не должна перенаправить запись за пределы дерева
+        ::unlinkat(dirFd, name.constData(), 0);
+        fd = ::openat(dirFd, name.constData(), flags, 0600);
+    }
+    if (fd < 0) {
+        *error = systemError("Не удалось создать файл", absolutePath(path));
+    }
+    return fd;
+}
+
+bool OutputTree::makeDirectory(const QString& path, QString* error) {
+    DirHandle dir;
+    return openDirectory(path, &dir, error);
+}
+
+bool OutputTree::writeFile(const QString& path, const char* data, qint64 size, int mode, qint64 mtime, QString* error) {
+    DirHandle dir;
+    QByteArray name;
+    if (!openParent(path, &dir, &name, error)) {
+        return false;
+    }
+    const int fd = openFileAt(dir.fd, name, path, error);
+    if (fd < 0) {
+        return false;
+    }
+    preallocate(fd, size);
+    if (!writeAll(fd, data, size)) {
+        *error = systemError("Ошибка записи", absolutePath(path));
+        ::close(fd);
+        return false;
+    }
+    if (!finishFile(fd, mode, mtime)) {
+        *error = systemError("Ошибка завершения записи", absolutePath(path));
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::createSymlink(const QString& path, const QString& target, QString* error) {
+    DirHandle dir;
+    QByteArray name;
+    if (!openParent(path, &dir, &name, error)) {
+        return false;
+    }
+    ::unlinkat(dir.fd, name.constData(), 0);
+    if (::symlinkat(QFile::encodeName(target).constData(), dir.fd, name.constData()) != 0) {
+        *error = systemError(QString("Не удалось создать ссылку на '%1'").arg(target), absolutePath(path));
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::createHardlink(const QString& path, const QString& existingPath, QString* error) {
+    DirHandle sourceDir;
+    QByteArray sourceName;
+    DirHandle dir;
+    QByteArray name;
+    if (!openParent(existingPath, &sourceDir, &sourceName, error) || !openParent(path, &dir, &name, error)) {
+        return false;
+    }
+    ::unlinkat(dir.fd, name.constData(), 0);
+    if (::linkat(sourceDir.fd, sourceName.constData(), dir.fd, name.constData(), 0) == 0) {
+        return true;
+    }
+    // ФС без жёстких ссылок - копируем, тоже относительно дескрипторов каталогов. Источником
+    // может быть только обычный файл дерева: ссылка из архива не должна вывести копию за его пределы
+    const int source = ::openat(sourceDir.fd, sourceName.constData(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    struct stat info;
+    if (source < 0 || ::fstat(source, &info) != 0 || !S_ISREG(info.st_mode)) {
+        *error = QString("Жёсткая ссылка '%1' указывает не на обычный файл '%2'").arg(absolutePath(path), existingPath);
+        if (source >= 0) {
+            ::close(source);
+        }
+        return false;
+    }
+    const int fd = openFileAt(dir.fd, name, path, error);
+    if (fd < 0) {
+        ::close(source);
+        return false;
+    }
+    QByteArray buffer(kCoalesceSize, Qt::Uninitialized);
+    bool ok = true;
+    for (;;) {
+        const ssize_t bytesRead = ::read(source, buffer.data(), static_cast<size_t>(buffer.size()));
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            ok = bytesRead == 0;
+            break;
+        }
+        if (!writeAll(fd, buffer.constData(), bytesRead)) {
+            ok = false;
+            break;
+        }
+    }
+    ::close(source);
+    if (!finishFile(fd, info.st_mode & 07777, info.st_mtime) || !ok) {
+        *error = systemError(QString("Не удалось скопировать '%1'").arg(existingPath), absolutePath(path));
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::supportsExternalLinks() {
+    return true;
+}
+
+bool OutputTree::linkExternal(const QString& sourcePath, const QString& path, QString* error) {
+    DirHandle dir;
+    QByteArray name;
+    if (!openParent(path, &dir, &name, error)) {
+        return false;
+    }
+    ::unlinkat(dir.fd, name.constData(), 0);
+    if (::linkat(AT_FDCWD, QFile::encodeName(sourcePath).constData(), dir.fd, name.constData(), 0) != 0) {
+        *error = systemError(QString("Не удалось создать жёсткую ссылку на '%1'").arg(sourcePath), absolutePath(path));
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::setDirectoryMode(const QString& path, int mode) {
+    if (path.isEmpty()) {
+        return ::fchmod(m_rootFd, static_cast<mode_t>(mode)) == 0;
+    }
+    DirHandle dir;
+    QByteArray name;
+    QString error;
+    if (!openParent(path, &dir, &name, &error)) {
+        return false;
+    }
+    return ::fchmodat(dir.fd, name.constData(), static_cast<mode_t>(mode), 0) == 0;
+}
+
+OutputTree::FileWriter::~FileWriter() {
+    abort();
+}
+
+bool OutputTree::FileWriter::open(OutputTree* tree, const QString& path, qint64 expectedSize, QString* error) {
+    DirHandle dir;
+    QByteArray name;
+    if (!tree->openParent(path, &dir, &name, error)) {
+        return false;
+    }
+    m_fd = tree->openFileAt(dir.fd, name, path, error);
+    if (m_fd < 0) {
+        return false;
+    }
+    m_path = tree->absolutePath(path);
+    preallocate(m_fd, expectedSize);
+    m_buffer.reserve(kCoalesceSize);
+    return true;
+}
+
+bool OutputTree::FileWriter::write(const char* data, qint64 size, QString* error) {
+    if (m_buffer.isEmpty() && size >= kCoalesceSize) {
+        if (!writeAll(m_fd, data, size)) {
+            *error = systemError("Ошибка записи", m_path);
+            return false;
+        }
+        return true;
+    }
+    m_buffer.append(data, static_cast<int>(size));
+    return m_buffer.size() < kCoalesceSize || flush(error);
+}
+
+bool OutputTree::FileWriter::flush(QString* error) {
+    if (!writeAll(m_fd, m_buffer.constData(), m_buffer.size())) {
+        *error = systemError("Ошибка записи", m_path);
+        return false;
+    }
+    m_buffer.resize(0);
+    return true;
+}
+
+bool OutputTree::FileWriter::close(int mode, qint64 mtime, QString* error) {
+    if (!flush(error)) {
+        abort();
+        return false;
+    }
+    const int fd = m_fd;
+    m_fd = -1;
+    if (!finishFile(fd, mode, mtime)) {
+        *error = systemError("Ошибка завершения записи", m_path);
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::FileWriter::isOpen() const {
+    return m_fd >= 0;
+}
+
+void OutputTree::FileWriter::abort() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_buffer.resize(0);
+}
+
+#else // Q_OS_UNIX
+
+bool OutputTree::open(QString* error) {
+    if (!QDir().mkpath(m_rootPath)) {
+        *error = QString("Не удалось создать папку '%1'").arg(m_rootPath);
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::makeDirectory(const QString& path, QString* error) {
+    if (!QDir().mkpath(absolutePath(path))) {
+        *error = QString("Не удалось создать папку '%1'").arg(absolutePath(path));
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::writeFile(const QString& path, const char* data, qint64 size, int mode, qint64 mtime, QString* error) {
+    FileWriter writer;
+    return writer.open(this, path, size, error) && writer.write(data, size, error) && writer.close(mode, mtime, error);
+}
+
+bool OutputTree::createSymlink(const QString& path, const QString& target, QString* error) {
+    QFile::remove(absolutePath(path));
+    if (!QFile::link(target, absolutePath(path))) {
+        *error = QString("Не удалось создать ссылку '%1' -> '%2'").arg(absolutePath(path), target);
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::createHardlink(const QString& path, const QString& existingPath, QString* error) {
+    // QFile::copy разыменовывает ссылки: копировать можно только обычный файл дерева
+    if (QFileInfo(absolutePath(existingPath)).isSymLink()) {
+        *error = QString("Жёсткая ссылка '%1' указывает не на обычный файл '%2'").arg(absolutePath(path), existingPath);
+        return false;
+    }
+    QFile::remove(absolutePath(path));
+    if (!QFile::copy(absolutePath(existingPath), absolutePath(path))) {
+        *error = QString("Не удалось скопировать '%1' в '%2'").arg(absolutePath(existingPath), absolutePath(path));
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::supportsExternalLinks() {
+    return false;
+}
+
+bool OutputTree::linkExternal(const QString& sourcePath, const QString& path, QString* error) {
+    // Без жёстких ссылок копия не сохранила бы время изменения - пусть файл будет записан заново
+    Q_UNUSED(sourcePath);
+    *error = QString("Жёсткие ссылки не поддерживаются: '%1'").arg(absolutePath(path));
+    return false;
+}
+
+bool OutputTree::setDirectoryMode(const QString& path, int mode) {
+    return QFile::setPermissions(absolutePath(path), permissionsFromMode(mode));
+}
+
+OutputTree::FileWriter::~FileWriter() {
+    abort();
+}
+
+bool OutputTree::FileWriter::open(OutputTree* tree, const QString& path, qint64 expectedSize, QString* error) {
+    Q_UNUSED(expectedSize);
+    m_path = tree->absolutePath(path);
+    if (QFileInfo(m_path).isSymLink()) {
+        QFile::remove(m_path);
+    }
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = QString("Не удалось создать файл '%1': %2").arg(m_path, m_file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::FileWriter::write(const char* data, qint64 size, QString* error) {
+    if (m_file.write(data, size) != size) {
+        *error = QString("Ошибка записи '%1': %2").arg(m_path, m_file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::FileWriter::flush(QString* error) {
+    Q_UNUSED(error);
+    return true;
+}
+
+bool OutputTree::FileWriter::close(int mode, qint64 mtime, QString* error) {
+    m_file.setPermissions(permissionsFromMode(mode));
+    m_file.setFileTime(QDateTime::fromSecsSinceEpoch(mtime), QFileDevice::FileModificationTime);
+    m_file.close();
+    if (m_file.error() != QFileDevice::NoError) {
+        *error = QString("Ошибка записи '%1': %2").arg(m_path, m_file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool OutputTree::FileWriter::isOpen() const {
+    return m_file.isOpen();
+}
+
+void OutputTree::FileWriter::abort() {
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+#endif // Q_OS_UNIX
\ No newline at end of file
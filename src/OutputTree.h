@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#ifndef Q_OS_UNIX
+#include <QFile>
+#endif
+
+// Дерево установки, в которое распаковщик пишет файлы.
+// На POSIX все операции выполняются относительно открытых дескрипторов каталогов
+// (openat/mkdirat/symlinkat/linkat/fchmod/futimens): путь разрешается один раз на
+// каталог, созданные каталоги кэшируются, размер крупных файлов резервируется заранее
+// по заголовку tar, мелкие порции записи объединяются. Промежуточные компоненты
+// открываются с O_NOFOLLOW, поэтому ссылка из архива не уведёт запись за пределы дерева.
+// На остальных платформах используется QFile/QDir по полным путям.
+//
+// Все пути - относительные и уже проверенные (без "..", не абсолютные); "" - корень.
+// Методы потокобезопасны.
+class OutputTree {
+public:
+    explicit OutputTree(const QString& rootPath);
+    ~OutputTree();
+
+    OutputTree(const OutputTree&) = delete;
+    OutputTree& operator=(const OutputTree&) = delete;
+
+    // Создаёт (при необходимости) и открывает корень дерева
+    bool open(QString* error);
+    QString rootPath() const { return m_rootPath; }
+    QString absolutePath(const QString& path) const;
+
+    bool makeDirectory(const QString& path, QString* error);
+    bool writeFile(const QString& path, const char* data, qint64 size, int mode, qint64 mtime, QString* error);
+    bool createSymlink(const QString& path, const QString& target, QString* error);
+    bool createHardlink(const QString& path, const QString& existingPath, QString* error);
+    bool setDirectoryMode(const QString& path, int mode);
+    // Жёсткая ссылка на файл вне дерева (sourcePath - полный путь, на той же ФС).
+    // Без копирования: при неудаче решение остаётся за вызывающим
+    bool linkExternal(const QString& sourcePath, const QString& path, QString* error);
+    static bool supportsExternalLinks();
+
+    // Потоковая запись крупного файла с объединением мелких порций
+    class FileWriter {
+    public:
+        FileWriter() = default;
+        ~FileWriter();
+
+        FileWriter(const FileWriter&) = delete;
+        FileWriter& operator=(const FileWriter&) = delete;
+
+        // expectedSize - размер из заголовка tar, под него заранее резервируется место
+        bool open(OutputTree* tree, const QString& path, qint64 expectedSize, QString* error);
+        bool write(const char* data, qint64 size, QString* error);
+        bool close(int mode, qint64 mtime, QString* error);
+        bool isOpen() const;
+        void abort();
+
+    private:
+        bool flush(QString* error);
+
+        QString m_path;
+        QByteArray m_buffer;
+#ifdef Q_OS_UNIX
+        int m_fd = -1;
+#else
+        QFile m_file;
+#endif
+    };
+
+private:
+#ifdef Q_OS_UNIX
+    // Дескриптор каталога: из кэша (не закрывается) или временный
+    struct DirHandle {
+        int fd = -1;
+        bool owned = false;
+        DirHandle() = default;
+        DirHandle(const DirHandle&) = delete;
+        DirHandle& operator=(const DirHandle&) = delete;
+        ~DirHandle();
+    };
+
+    bool openDirectory(const QString& path, DirHandle* dir, QString* error);
+    bool openParent(const QString& path, DirHandle* dir, QByteArray* name, QString* error);
+    int openFileAt(int dirFd, const QByteArray& name, const QString& path, QString* error);
+
+    int m_rootFd = -1;
+    QMutex m_cacheMutex;
+    QHash<QString, int> m_dirCache; // Относительный путь каталога -> открытый дескриптор
+#endif
+
+    QString m_rootPath;
+};
\ No newline at end of file
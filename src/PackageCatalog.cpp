@@ -0,0 +1,233 @@
+#include "PackageCatalog.h"
+#include "StreamDecoder.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+
+namespace {
+
+constexpr quint32 kIndexMagic = 0x504b4358; // "PKCX"
+constexpr quint16 kIndexVersion = 4;
+
+constexpr int kSha256Size = 32;
+
+// Шестнадцатеричная сумма из манифеста; пустое значение - суммы нет
+QByteArray digestFromHex(const QJsonValue& value) {
+    return QByteArray::fromHex(value.toString().toLatin1());
+}
+
+PackageInfo packageFromJson(const QJsonObject& object) {
+    PackageInfo package;
+    package.id = object.value("id").toString();
+    package.displayName = object.value("displayName").toString(package.id);
+    package.resourcePath = object.value("resourcePath").toString();
+    package.targetSubDir = object.value("targetSubDir").toString(package.id);
+    package.bundleFile = object.value("bundle").toString();
+    package.format = StreamDecoder::formatFromName(object.value("format").toString());
+    package.archiveSha256 = digestFromHex(object.value("sha256"));
+    package.deltaFrom = object.value("deltaFrom").toString();
+    // Пути записей приводятся к виду, в котором их видит распаковщик
+    const QJsonObject entries = object.value("entries").toObject();
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        package.entrySha256.insert(QDir::cleanPath(it.key()), digestFromHex(it.value()));
+    }
+    return package;
+}
+
+bool hasValidDigests(const PackageInfo& package) {
+    if (!package.archiveSha256.isEmpty() && package.archiveSha256.size() != kSha256Size) {
+        return false;
+    }
+    for (const QByteArray& digest : package.entrySha256) {
+        if (digest.size() != kSha256Size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QDataStream& operator<<(QDataStream& stream, const PackageInfo& package) {
+    return stream << package.id << package.displayName << package.resourcePath
+                  << package.targetSubDir << package.bundleFile << quint8(package.format)
+                  << package.archiveSha256 << package.entrySha256 << package.deltaFrom;
+}
+
+QDataStream& operator>>(QDataStream& stream, PackageInfo& package) {
+    quint8 format = 0;
+    stream >> package.id >> package.displayName >> package.resourcePath
+           >> package.targetSubDir >> package.bundleFile >> format
+           >> package.archiveSha256 >> package.entrySha256 >> package.deltaFrom;
+    package.format = static_cast<ArchiveFormat>(format);
+    return stream;
+}
+
+} // namespace
+
+bool PackageCatalog::isSafeName(const QString& name) {
+    return !name.isEmpty() && name != "." && name != ".." && !name.contains('/') && !name.contains('\\') &&
+           !name.contains(QChar(0));
+}
+
+bool PackageCatalog::hasSafeNames(const PackageInfo& package) {
+    // Из id строятся пути индексов в .packman, из targetSubDir - папка установки, которая
+    // при переустановке удаляется целиком: ни то, ни другое не должно выйти за корень установки
+    return isSafeName(package.id) && isSafeName(package.targetSubDir) &&
+           (package.deltaFrom.isEmpty() || isSafeName(package.deltaFrom));
+}
+
+QString PackageCatalog::indexPathFor(const QString& manifestPath) {
+    const QFileInfo info(manifestPath);
+    return info.absolutePath() + '/' + info.completeBaseName() + ".idx";
+}
+
+bool PackageCatalog::loadManifest(const QString& manifestPath, QString* error) {
+    // Свежий двоичный индекс читается намного быстрее разбора JSON
+    const QString indexPath = indexPathFor(manifestPath);
+    const QFileInfo manifestInfo(manifestPath);
+    const QFileInfo indexInfo(indexPath);
+    if (indexInfo.exists() && indexInfo.lastModified() >= manifestInfo.lastModified() && loadIndex(indexPath)) {
+        return true;
+    }
+
+    QFile file(manifestPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) { *error = QString("Не удалось открыть манифест '%1': %2").arg(manifestPath, file.errorString()); }
+        return false;
+    }
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        if (error) { *error = QString("Ошибка разбора манифеста '%1': %2").arg(manifestPath, parseError.errorString()); }
+        return false;
+    }
+
+    const QJsonArray entries = document.object().value("packages").toArray();
+    QVector<PackageInfo> packages;
+    packages.reserve(entries.size());
+    for (const QJsonValue& entry : entries) {
+        PackageInfo package = packageFromJson(entry.toObject());
+        // Пакет с путями за пределами корня установки или с испорченной контрольной суммой не показываем
+        if (!hasSafeNames(package) || package.resourcePath.isEmpty() || !hasValidDigests(package)) {
+            qWarning() << "Пакет пропущен: недопустимое описание в манифесте" << package.id;
+            continue;
+        }
+        packages.append(package);
+    }
+    setPackages(packages);
+
+    // Кэш индекса необязателен: папка может быть доступна только для чтения
+    saveIndex(indexPath);
+    return true;
+}
+
+bool PackageCatalog::saveIndex(const QString& indexPath, QString* error) const {
+    QSaveFile file(indexPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << kIndexMagic << kIndexVersion << quint32(m_packages.size());
+    for (const PackageInfo& package : m_packages) {
+        stream << package;
+    }
+    if (!file.commit()) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    return true;
+}
+
+bool PackageCatalog::loadIndex(const QString& indexPath, QString* error) {
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    // Читаем прямо из отображения файла, без промежуточного буфера
+    uchar* mapped = file.map(0, file.size());
+    QByteArray bytes = mapped ? QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), static_cast<int>(file.size()))
+                              : file.readAll();
+    QDataStream stream(bytes);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != kIndexMagic || version != kIndexVersion) {
+        if (error) { *error = QString("Индекс '%1' устарел или повреждён").arg(indexPath); }
+        return false;
+    }
+
+    QVector<PackageInfo> packages;
+    packages.reserve(static_cast<int>(qMin<quint32>(count, 1u << 20)));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        PackageInfo package;
+        stream >> package;
+        // Индекс лежит рядом с манифестом и мог быть подменён отдельно от него
+        if (hasSafeNames(package)) {
+            packages.append(package);
+        }
+    }
+    if (stream.status() != QDataStream::Ok) {
+        if (error) { *error = QString("Индекс '%1' повреждён").arg(indexPath); }
+        return false;
+    }
+    setPackages(packages);
+    return true;
+}
+
+void PackageCatalog::setPackages(const QVector<PackageInfo>& packages) {
+    m_packages = packages;
+    rebuildIndexes();
+}
+
+const PackageInfo* PackageCatalog::find(const QString& id) const {
+    const auto it = m_indexById.constFind(id);
+    return it == m_indexById.constEnd() ? nullptr : &m_packages.at(it.value());
+}
+
+QVector<int> PackageCatalog::findByPrefix(const QString& prefix, int limit) const {
+    const QString key = prefix.toCaseFolded();
+    QVector<int> result;
+    auto it = std::lower_bound(m_sortedKeys.cbegin(), m_sortedKeys.cend(), key);
+    for (; it != m_sortedKeys.cend() && it->startsWith(key); ++it) {
+        if (limit >= 0 && result.size() >= limit) {
+            break;
+        }
+        result.append(m_byName.at(static_cast<int>(it - m_sortedKeys.cbegin())));
+    }
+    return result;
+}
+
+void PackageCatalog::rebuildIndexes() {
+    m_indexById.clear();
+    m_indexById.reserve(m_packages.size());
+    m_byName.resize(m_packages.size());
+    for (int i = 0; i < m_packages.size(); ++i) {
+        m_indexById.insert(m_packages.at(i).id, i);
+        m_byName[i] = i;
+    }
+
+    QVector<QString> keys(m_packages.size());
+    for (int i = 0; i < m_packages.size(); ++i) {
+        keys[i] = m_packages.at(i).displayName.toCaseFolded();
+    }
+    std::sort(m_byName.begin(), m_byName.end(), [&keys](int a, int b) { return keys.at(a) < keys.at(b); });
+
+    m_sortedKeys.resize(m_packages.size());
+    for (int i = 0; i < m_byName.size(); ++i) {
+        m_sortedKeys[i] = keys.at(m_byName.at(i));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "PackageInfo.h"
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Каталог пакетов, загружаемый из манифеста.
+// Исходный манифест - JSON (packages.json); рядом с ним кэшируется компактный двоичный
+// индекс (packages.idx), который читается из отображённого в память файла и
+// используется, пока он не старее манифеста. Поиск по id - O(1) через хэш,
+// поиск по префиксу имени - двоичный поиск по отсортированному индексу имён.
+class PackageCatalog {
+public:
+    PackageCatalog() = default;
+
+    // Загружает манифест. При ошибке каталог не меняется, текст ошибки в *error
+    bool loadManifest(const QString& manifestPath, QString* error = nullptr);
+    // Двоичный индекс: запись и чтение
+    bool saveIndex(const QString& indexPath, QString* error = nullptr) const;
+    bool loadIndex(const QString& indexPath, QString* error = nullptr);
+
+    // Заменяет содержимое каталога (например, встроенными определениями)
+    void setPackages(const QVector<PackageInfo>& packages);
+
+    int size() const { return m_packages.size(); }
+    bool isEmpty() const { return m_packages.isEmpty(); }
+    const PackageInfo& at(int index) const { return m_packages.at(index); }
+    const QVector<PackageInfo>& packages() const { return m_packages; }
+
+    // Пакет по id или nullptr
+    const PackageInfo* find(const QString& id) const;
+    // Индексы пакетов, отображаемое имя которых начинается с prefix (без учёта регистра),
+    // в алфавитном порядке; limit < 0 - без ограничения
+    QVector<int> findByPrefix(const QString& prefix, int limit = -1) const;
+
+    // Путь двоичного индекса для данного манифеста
+    static QString indexPathFor(const QString& manifestPath);
+    // Годится ли строка как один компонент пути (id пакета, папка установки): не пустая,
+    // не "." и "..", без разделителей каталогов
+    static bool isSafeName(const QString& name);
+    // id, папка установки и базовая версия пакета - безопасные имена
+    static bool hasSafeNames(const PackageInfo& package);
+
+private:
+    void rebuildIndexes();
+
+    QVector<PackageInfo> m_packages;
+    QHash<QString, int> m_indexById;
+    QVector<int> m_byName;         // Индексы пакетов, отсортированные по имени
+    QVector<QString> m_sortedKeys; // Приведённые к нижнему регистру имена в том же порядке
+};
\ No newline at end of file
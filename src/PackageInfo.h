@@ -1,12 +1,28 @@
 #pragma once
 
+#include <QByteArray>
+#include <QHash>
 #include <QString>
 #include <QStringList>
 
+// Формат сжатия архива пакета
+enum class ArchiveFormat {
+    Auto, // Определяется по сигнатуре
+    Gzip,
+    Zstd,
+    Xz,
+    Tar   // Несжатый tar
+};
+
 // Структура для хранения информации о пакете
 struct PackageInfo {
     QString id; // Уникальный идентификатор пакета
     QString displayName; // Отображаемое имя
     QString resourcePath; // Путь к архиву пакета в системе ресурсов Qt (например, ":/packages/my_package.tar.gz")
     QString targetSubDir; // Имя папки для распаковки
+    QString bundleFile; // Внешний .rcc с архивом (относительно папки приложения); пусто - ресурс встроен в бинарник
+    ArchiveFormat format = ArchiveFormat::Auto; // Формат архива
+    QByteArray archiveSha256; // Ожидаемый SHA-256 файла архива (32 байта); пусто - не проверяется
+    QHash<QString, QByteArray> entrySha256; // Ожидаемые SHA-256 отдельных файлов (путь в архиве -> 32 байта)
+    QString deltaFrom; // Для дельта-пакета - id пакета, установленная версия которого обновляется; пусто - полный архив
 };
\ No newline at end of file
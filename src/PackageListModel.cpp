@@ -0,0 +1,64 @@
+#include "PackageListModel.h"
+#include "PackageCatalog.h"
+
+namespace {
+
+// Размер порции, отдаваемой представлению за один fetchMore()
+constexpr int kFetchBatch = 256;
+
+} // namespace
+
+PackageListModel::PackageListModel(const PackageCatalog* catalog, QObject *parent)
+    : QAbstractListModel(parent), m_catalog(catalog) {
+    reload();
+}
+
+int PackageListModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : m_fetched;
+}
+
+QVariant PackageListModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= m_fetched) {
+        return QVariant();
+    }
+    const PackageInfo& package = m_catalog->at(m_rows.at(index.row()));
+    switch (role) {
+    case Qt::DisplayRole:
+        return package.displayName;
+    case Qt::ToolTipRole:
+        return package.id;
+    case PackageIdRole:
+        return package.id;
+    default:
+        return QVariant();
+    }
+}
+
+bool PackageListModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && m_fetched < m_rows.size();
+}
+
+void PackageListModel::fetchMore(const QModelIndex& parent) {
+    if (parent.isValid()) {
+        return;
+    }
+    const int count = qMin(kFetchBatch, m_rows.size() - m_fetched);
+    if (count <= 0) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), m_fetched, m_fetched + count - 1);
+    m_fetched += count;
+    endInsertRows();
+}
+
+void PackageListModel::setFilterPrefix(const QString& prefix) {
+    m_filterPrefix = prefix;
+    reload();
+}
+
+void PackageListModel::reload() {
+    beginResetModel();
+    m_rows = m_catalog->findByPrefix(m_filterPrefix);
+    m_fetched = qMin(kFetchBatch, m_rows.size());
+    endResetModel();
+}
\ No newline at end of file
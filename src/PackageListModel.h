@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QVector>
+
+class PackageCatalog;
+
+// Ленивая модель списка пакетов для QComboBox/QListView.
+// Строки не копируются: модель хранит только индексы каталога и отдаёт их
+// представлению порциями через canFetchMore()/fetchMore().
+class PackageListModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    enum Roles {
+        PackageIdRole = Qt::UserRole // id пакета (то же, что Qt::UserRole у QComboBox::currentData)
+    };
+
+    explicit PackageListModel(const PackageCatalog* catalog, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    // Оставляет только пакеты, имя которых начинается с prefix; пустая строка - все пакеты
+    void setFilterPrefix(const QString& prefix);
+    // Перечитать каталог после его перезагрузки
+    void reload();
+
+private:
+    const PackageCatalog* m_catalog;
+    QString m_filterPrefix;
+    QVector<int> m_rows;   // Индексы пакетов в каталоге в порядке отображения
+    int m_fetched = 0;     // Сколько строк уже отдано представлению
+};
\ No newline at end of file
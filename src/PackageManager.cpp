@@ -1,47 +1,247 @@
 #include "PackageManager.h"
+#include "ArchiveExtractor.h"
+#include "ContentStore.h"
+#include "ExtractionJournal.h"
+#include "InstalledIndex.h"
+#include "InstallScheduler.h"
+#include "ResourceBundles.h"
+#include "StreamDecoder.h"
+#include "Trace.h"
 
 #include <QFile>
 #include <QDir>
-#include <QTemporaryDir>
-#include <QProcess>
+#include <QFileInfo>
+#include <QDateTime>
 #include <QDebug>
+#include <QCoreApplication>
+#include <QTimer>
 #include <QThread>
-#include <QApplication>
 
-PackageManager::PackageManager(QObject *parent) : QObject(parent) {
+#include <cstdio>
+
+namespace {
+
+// Частота обновления прогресса для UI
+constexpr int kProgressTickMs = 100;
+// Коэффициент экспоненциального сглаживания скорости
+constexpr double kRateSmoothing = 0.3;
+
+void makeTreeWritable(const QString& dirPath) {
+    QFile::setPermissions(dirPath, QFile::permissions(dirPath) | QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    const QFileInfoList children =
+        QDir(dirPath).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System | QDir::NoSymLinks);
+    for (const QFileInfo& child : children) {
+        makeTreeWritable(child.filePath());
+    }
+}
+
+// Удаляет распакованное дерево целиком: каталоги, которым архив задал права только на чтение
+// (например, 0555), сначала открываются на запись, иначе их содержимое не удалить
+bool removeTree(const QString& path) {
+    const QFileInfo info(path);
+    if (info.isSymLink() || (info.exists() && !info.isDir())) {
+        return QFile::remove(path);
+    }
+    if (!info.exists()) {
+        return true;
+    }
+    makeTreeWritable(path);
+    return QDir(path).removeRecursively();
+}
+
+// Переносит проверенную установку из промежуточной папки на место целевой.
+// Прежняя версия пакета удаляется только после успешной замены
+bool commitStagedInstall(const QString& stagingPath, const QString& targetPath, QString* error) {
+    PACKMAN_TRACE_SCOPE("commit");
+    const QString previousPath = targetPath + ".old";
+    // Остаток прошлой замены, который не удаётся удалить, убирается с дороги под другим именем:
+    // иначе ни одна следующая установка не освободит целевую папку
+    if (!removeTree(previousPath)) {
+        const QString stalePath = previousPath + '.' + QString::number(QDateTime::currentMSecsSinceEpoch());
+        if (!QDir().rename(previousPath, stalePath)) {
+            *error = QString("Не удалось удалить '%1'").arg(previousPath);
+            return false;
+        }
+        qWarning() << "Не удалось удалить" << previousPath << "- оставлено как" << stalePath;
+    }
+    if (QFileInfo::exists(targetPath) && !QDir().rename(targetPath, previousPath)) {
+        *error = QString("Не удалось освободить папку '%1'").arg(targetPath);
+        return false;
+    }
+    if (!QDir().rename(stagingPath, targetPath)) {
+        QDir().rename(previousPath, targetPath);
+        *error = QString("Не удалось переместить '%1' в '%2'").arg(stagingPath, targetPath);
+        return false;
+    }
+    PACKMAN_TRACE_SCOPE("cleanup.previous");
+    if (!removeTree(previousPath)) {
+        // Установка уже на месте; остаток уберёт следующая замена
+        qWarning() << "Не удалось удалить" << previousPath;
+    }
+    return true;
+}
+
+// Переносит распакованные выборочно записи из промежуточной папки в существующую установку.
+// Новые файлы и каталоги переносятся целиком, существующие файлы заменяются переименованием
+bool moveStagedEntries(const QString& stagingDir, const QString& targetDir, QString* error) {
+    // Из каталога, ставшего read-only после распаковки, иначе ничего не перенести
+    QFile::setPermissions(stagingDir, QFile::permissions(stagingDir) | QFile::WriteOwner | QFile::ExeOwner);
+    const QFileInfoList staged =
+        QDir(stagingDir).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+    for (const QFileInfo& source : staged) {
+        const QString targetPath = QDir(targetDir).filePath(source.fileName());
+        const QFileInfo target(targetPath);
+        const bool targetExists = target.exists() || target.isSymLink();
+        const bool sourceIsDir = source.isDir() && !source.isSymLink();
+        if (targetExists && sourceIsDir && target.isDir() && !target.isSymLink()) {
+            if (!moveStagedEntries(source.filePath(), targetPath, error)) {
+                return false;
+            }
+            continue;
+        }
+        if (targetExists && (sourceIsDir || (target.isDir() && !target.isSymLink()))) {
+            *error = QString("'%1' в установке и в пакете - записи разного типа").arg(targetPath);
+            return false;
+        }
+#ifndef Q_OS_UNIX
+        // rename() поверх существующего файла заменяет его только в POSIX
+        if (targetExists) {
+            QFile::remove(targetPath);
+        }
+#endif
+        if (std::rename(QFile::encodeName(source.filePath()).constData(), QFile::encodeName(targetPath).constData()) != 0) {
+            *error = QString("Не удалось переместить '%1' в '%2'").arg(source.filePath(), targetPath);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+PackageManager::PackageManager(QObject *parent)
+    : QObject(parent),
+      m_installRoot(QDir::homePath() + QDir::separator() + "MyInstalledApps") {
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setInterval(kProgressTickMs);
+    connect(m_progressTimer, &QTimer::timeout, this, &PackageManager::publishProgress);
+    m_progressClock.start();
+
+    m_scheduler = new InstallScheduler(&PackageManager::runInstallJob, this);
+    connect(m_scheduler, &InstallScheduler::jobStarted, this, [this](int jobId, const QString& packageName) {
+        m_progressSamples.insert(jobId, ProgressSample{0, m_progressClock.elapsed(), 0.0});
+        if (!m_progressTimer->isActive()) {
+            m_progressTimer->start();
+        }
+        emit installationStarted(packageName);
+        emit statusMessage(QString("Начало установки: %1 (задание %2)").arg(packageName).arg(jobId));
+    });
+    connect(m_scheduler, &InstallScheduler::jobFinished, this,
+            [this](int jobId, const QString& packageName, bool success, const QString& message) {
+        // Финальный снимок, чтобы индикатор дошёл до конца без ожидания тика
+        for (const InstallJob& job : m_scheduler->jobs()) {
+            if (job.id == jobId) {
+                InstallProgress progress = sampleProgress(job);
+                progress.phase = InstallPhase::Finished;
+                progress.etaSeconds = 0.0;
+                emit progressChanged(progress);
+                break;
+            }
+        }
+        m_progressSamples.remove(jobId);
+
+        emit statusMessage(message);
+        emit installationFinished(packageName, success, message);
+    });
+    connect(m_scheduler, &InstallScheduler::jobCancelled, this,
+            [this](int jobId, const QString& packageName, const QString& message) {
+        Q_UNUSED(jobId);
+        emit statusMessage(message);
+        emit installationCancelled(packageName, message);
+    });
+    connect(m_scheduler, &InstallScheduler::allJobsFinished, this, [this]() {
+        m_progressTimer->stop();
+        emit allInstallationsFinished();
+    });
+
     loadPackageDefinitions();
 }
 
 PackageManager::~PackageManager() = default;
 
 void PackageManager::loadPackageDefinitions() {
-    // Определяем пакеты, используя короткие псевдонимы из .qrc
-    availablePackages.append({
+    // Основной источник - манифест рядом с приложением (с кэшем двоичного индекса)
+    const QString manifestPath = QDir(ResourceBundles::searchPath()).filePath("packages.json");
+    QString error;
+    if (QFileInfo::exists(manifestPath) && m_catalog.loadManifest(manifestPath, &error)) {
+        emit statusMessage("Определения пакетов загружены из манифеста. Доступно: " + QString::number(m_catalog.size()));
+        return;
+    }
+    if (!error.isEmpty()) {
+        qWarning() << error;
+    }
+
+    // Запасной вариант: встроенные определения, использующие короткие псевдонимы из .qrc
+    QVector<PackageInfo> packages;
+    packages.append({
         "postgresql",
         "PostgreSQL 17.5 (Source)", // Отображаемое имя
         ":/packages/postgresql.tar.gz",
-        "postgresql-17.5" // Имя папки для распаковки
+        "postgresql-17.5", // Имя папки для распаковки
+        "packages.rcc" // Бандл, из которого берётся архив
     });
 
-    availablePackages.append({
+    packages.append({
         "openldap",
         "OpenLDAP 2.6.10 (Source)",
         ":/packages/openldap.tgz",
-        "openldap-2.6.10"
+        "openldap-2.6.10",
+        "packages.rcc"
     });
+    m_catalog.setPackages(packages);
 
-    emit statusMessage("Определения пакетов загружены. Доступно: " + QString::number(availablePackages.size()));
+    emit statusMessage("Определения пакетов загружены. Доступно: " + QString::number(m_catalog.size()));
 }
 
-QList<PackageInfo> PackageManager::getAvailablePackages() const {
-    return availablePackages;
+const PackageInfo* PackageManager::findPackage(const QString& id) const {
+    return m_catalog.find(id);
 }
 
-void PackageManager::installPackage(const PackageInfo& package) {
-    emit installationStarted(package.displayName);
-    emit statusMessage(QString("Начало установки: %1").arg(package.displayName));
+int PackageManager::installPackage(const PackageInfo& package, const QStringList& paths) {
+    // Папка установки при замене версии удаляется целиком - она должна лежать внутри корня
+    if (!PackageCatalog::hasSafeNames(package)) {
+        QString errorMsg = QString("Недопустимое имя пакета или папки установки: '%1'").arg(package.id);
+        emit statusMessage(errorMsg);
+        emit installationFinished(package.displayName, false, errorMsg);
+        return 0;
+    }
+    if (m_scheduler->isPending(package.id)) {
+        emit statusMessage(QString("Пакет '%1' уже в очереди на установку").arg(package.displayName));
+        return 0;
+    }
 
-    // 1. Проверка наличия ресурса
+    // 1. Подключение бандла с архивом (только сейчас, когда пакет действительно выбран)
+    QString bundleError;
+    bool bundleRegistered = false;
+    {
+        PACKMAN_TRACE_SCOPE("bundle.register");
+        bundleRegistered = ResourceBundles::ensureRegistered(package.bundleFile, &bundleError);
+    }
+    if (!bundleRegistered) {
+        emit statusMessage(bundleError);
+        emit installationFinished(package.displayName, false, bundleError);
+        return 0;
+    }
+
+    if (!StreamDecoder::isSupported(package.format)) {
+        QString errorMsg = QString("Формат архива '%1' (%2) не поддерживается этой сборкой")
+                               .arg(package.displayName, StreamDecoder::formatName(package.format));
+        emit statusMessage(errorMsg);
+        emit installationFinished(package.displayName, false, errorMsg);
+        return 0;
+    }
+
+    // 2. Проверка наличия ресурса
     QFile resourceFile(package.resourcePath);
     if (!resourceFile.exists() || resourceFile.size() == 0) {
         QString errorMsg = QString("КРИТИЧЕСКАЯ ОШИБКА: Ресурс '%1' не найден или пуст. Проверьте, что:\n1. Приложение запущено из папки сборки.\n2. Файл 'packages.rcc' существует и не пустой.\n3. Путь в коде ('%2') и alias в .qrc ('%3') совпадают.")
@@ -51,65 +251,385 @@ void PackageManager::installPackage(const PackageInfo& package) {
         emit statusMessage(errorMsg);
         emit installationFinished(package.displayName, false, errorMsg);
         qWarning() << errorMsg;
-        return;
+        return 0;
     }
 
-    // 2. Создание временной директории
-    m_tempDir.reset(new QTemporaryDir);
-    if (!m_tempDir->isValid()) {
-        QString errorMsg = QString("Ошибка: Не удалось создать временную директорию.");
+    // Дельта-пакет обновляет установленную базовую версию и без неё бесполезен
+    QString basePath;
+    if (!package.deltaFrom.isEmpty() && !paths.isEmpty()) {
+        QString errorMsg = QString("Обновление '%1' устанавливается только целиком").arg(package.displayName);
         emit statusMessage(errorMsg);
         emit installationFinished(package.displayName, false, errorMsg);
-        return;
+        return 0;
+    }
+    if (!package.deltaFrom.isEmpty()) {
+        const PackageInfo* base = findPackage(package.deltaFrom);
+        basePath = base ? installPathFor(*base) : QString();
+        if (!base || !QFileInfo(basePath).isDir() || !QFileInfo::exists(InstalledIndex::pathFor(m_installRoot, base->id))) {
+            QString errorMsg = QString("Обновление '%1' требует установленного пакета '%2'")
+                                   .arg(package.displayName, base ? base->displayName : package.deltaFrom);
+            emit statusMessage(errorMsg);
+            emit installationFinished(package.displayName, false, errorMsg);
+            return 0;
+        }
     }
 
-    QString tempPath = m_tempDir->path();
-    QString archiveFileName = QFileInfo(package.resourcePath).fileName();
-    QString tempArchivePath = tempPath + QDir::separator() + archiveFileName;
+    // 3. Постановка в очередь; распаковка пойдёт в пуле рабочих потоков
+    InstallJob job;
+    job.package = package;
+    job.targetPath = installPathFor(package);
+    job.basePath = basePath;
+    job.storePath = m_contentStoreEnabled ? ContentStore::defaultPathFor(m_installRoot) : QString();
+    job.paths = paths;
+    // Одновременные задания делят и память, и ядра: иначе каждое запустило бы свой полный набор потоков
+    job.memoryBudget = m_memoryBudget / maxConcurrentInstalls();
+    job.threadCount = qMax(1, QThread::idealThreadCount() / maxConcurrentInstalls());
+    const int jobId = m_scheduler->enqueue(job);
+    emit statusMessage(QString("Пакет '%1' поставлен в очередь установки (задание %2)").arg(package.displayName).arg(jobId));
+    return jobId;
+}
 
-    // 3. Копирование архива
-    emit statusMessage("Копирование архива во временную папку (может занять время)...");
-    if (!resourceFile.copy(tempArchivePath)) {
-        QString errorMsg = QString("Ошибка: Не удалось скопировать ресурс: %1").arg(resourceFile.errorString());
-        emit statusMessage(errorMsg);
-        emit installationFinished(package.displayName, false, errorMsg);
-        return;
+bool PackageManager::listContents(const PackageInfo& package, QList<ArchiveEntry>* entries, QString* error) {
+    if (!ResourceBundles::ensureRegistered(package.bundleFile, error)) {
+        return false;
     }
-    emit statusMessage(QString("Ресурс скопирован в '%1'").arg(tempArchivePath));
-
-    // 4. Создание папки установки
-    QString installBaseDir = QDir::homePath() + QDir::separator() + "MyInstalledApps";
-    QString targetInstallPath = installBaseDir + QDir::separator() + package.targetSubDir;
-    if (!QDir(installBaseDir).exists()) { QDir().mkpath(installBaseDir); }
-    if (!QDir(targetInstallPath).exists()) { QDir().mkpath(targetInstallPath); }
-
-    // 5. Распаковка архива
-    QProcess *unpacker = new QProcess(this);
-    QString program = "tar";
-    QStringList arguments;
-    arguments << "xzf" << tempArchivePath << "-C" << targetInstallPath;
-
-    emit statusMessage(QString("Запуск распаковки: %1 %2").arg(program, arguments.join(" ")));
-
-    connect(unpacker, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, [=](int exitCode, QProcess::ExitStatus exitStatus) {
-        if (exitStatus == QProcess::NormalExit && exitCode == 0) {
-            QString successMsg = QString("Пакет '%1' успешно распакован в '%2'")
-                                     .arg(package.displayName, targetInstallPath);
-            emit statusMessage(successMsg);
-            emit installationFinished(package.displayName, true, successMsg);
+    ArchiveIndex index;
+    if (!index.load(ArchiveIndex::pathFor(package.resourcePath)) && !ArchiveIndex::scan(package.resourcePath, &index, error)) {
+        return false;
+    }
+    *entries = index.entries();
+    return true;
+}
+
+bool PackageManager::cancelInstallation(int jobId) {
+    return m_scheduler->cancel(jobId);
+}
+
+void PackageManager::cancelAllInstallations() {
+    m_scheduler->cancelAll();
+}
+
+void PackageManager::setMaxConcurrentInstalls(int count) {
+    m_scheduler->setMaxConcurrentJobs(count);
+}
+
+int PackageManager::maxConcurrentInstalls() const {
+    return m_scheduler->maxConcurrentJobs();
+}
+
+bool PackageManager::isBusy() const {
+    return m_scheduler->isBusy();
+}
+
+void PackageManager::setInstallRoot(const QString& path) {
+    m_installRoot = QDir::cleanPath(path);
+}
+
+QString PackageManager::installPathFor(const PackageInfo& package) const {
+    return m_installRoot + QDir::separator() + package.targetSubDir;
+}
+
+void PackageManager::publishProgress() {
+    for (const InstallJob& job : m_scheduler->runningJobs()) {
+        emit progressChanged(sampleProgress(job));
+    }
+}
+
+InstallProgress PackageManager::sampleProgress(const InstallJob& job) {
+    const InstallCounters& counters = *job.counters;
+    InstallProgress progress;
+    progress.jobId = job.id;
+    progress.packageName = job.package.displayName;
+    progress.phase = static_cast<InstallPhase>(counters.phase.load(std::memory_order_relaxed));
+    progress.bytesTotal = counters.bytesTotal.load(std::memory_order_relaxed);
+    progress.bytesIn = counters.bytesIn.load(std::memory_order_relaxed);
+    progress.bytesOut = counters.bytesOut.load(std::memory_order_relaxed);
+    progress.entries = counters.entries.load(std::memory_order_relaxed);
+    progress.openNs = counters.openNs.load(std::memory_order_relaxed);
+    progress.decodeNs = counters.decodeNs.load(std::memory_order_relaxed);
+    progress.writeNs = counters.writeNs.load(std::memory_order_relaxed);
+    progress.finalizeNs = counters.finalizeNs.load(std::memory_order_relaxed);
+
+    ProgressSample& sample = m_progressSamples[job.id];
+    const qint64 now = m_progressClock.elapsed();
+    const qint64 elapsedMs = now - sample.lastMs;
+    if (elapsedMs > 0) {
+        const double instantRate = double(progress.bytesIn - sample.lastBytes) * 1000.0 / double(elapsedMs);
+        sample.rate = sample.rate > 0.0 ? sample.rate + kRateSmoothing * (instantRate - sample.rate) : instantRate;
+        sample.lastBytes = progress.bytesIn;
+        sample.lastMs = now;
+    }
+    progress.bytesPerSecond = sample.rate;
+    if (sample.rate > 0.0 && progress.bytesTotal > 0) {
+        progress.etaSeconds = double(progress.bytesTotal - progress.bytesIn) / sample.rate;
+    }
+    return progress;
+}
+
+bool PackageManager::runInstallJob(const InstallJob& job, QString* message) {
+    // Выполняется в рабочем потоке: только локальное состояние, никаких обращений к GUI
+    PACKMAN_TRACE_SCOPE("install");
+    if (!job.paths.isEmpty()) {
+        return runPartialInstallJob(job, message);
+    }
+    const PackageInfo& package = job.package;
+    const QString& targetInstallPath = job.targetPath;
+
+    // Потоковая распаковка прямо из ресурса, без временной копии и внешнего tar.
+    // Распаковка идёт в промежуточную папку: пакет, не прошедший проверку сумм,
+    // не затрагивает целевую папку
+    const QString stagingPath = targetInstallPath + ".partial";
+    ExtractionJournal journal(targetInstallPath + ".journal");
+
+    // Установка того же архива (сверяется и отпечаток содержимого), прерванная вместе с процессом, продолжается с последней
+    // контрольной точки. Иначе остатки прошлых попыток удаляются
+    // Дельта-пакет начинается с манифеста, поэтому продолжать его с середины нельзя
+    const bool isDelta = !job.basePath.isEmpty();
+    ExtractionCheckpoint checkpoint;
+    const bool canResume = !isDelta && journal.load(&checkpoint) && QFileInfo::exists(stagingPath) &&
+                           checkpoint.archivePath == package.resourcePath &&
+                           checkpoint.archiveSize == QFileInfo(package.resourcePath).size() &&
+                           checkpoint.archiveFingerprint == ExtractionJournal::fingerprint(package.resourcePath, package.archiveSha256);
+    if (!canResume) {
+        PACKMAN_TRACE_SCOPE("cleanup.staging");
+        checkpoint = ExtractionCheckpoint();
+        journal.remove();
+        removeTree(stagingPath);
+    }
+
+    // Индекс прежней установки: неизменившиеся файлы связываются из неё, а не пишутся заново
+    const QString installRoot = QFileInfo(targetInstallPath).absolutePath();
+    const QString indexPath = InstalledIndex::pathFor(installRoot, package.id);
+    InstalledIndex baseline;
+    const bool haveBaseline = !isDelta && QFileInfo(targetInstallPath).isDir() && baseline.load(indexPath);
+
+    // Индекс базовой версии для дельта-пакета: по нему проверяются её файлы
+    const QString deltaIndexPath = isDelta ? InstalledIndex::pathFor(installRoot, package.deltaFrom) : QString();
+    InstalledIndex deltaBase;
+    if (isDelta && !deltaBase.load(deltaIndexPath)) {
+        *message = QString("Ошибка обновления '%1': нет индекса установленной версии '%2'").arg(package.displayName, package.deltaFrom);
+        return false;
+    }
+
+    // Хранилище должно быть на той же файловой системе, что и установка: иначе ссылки не создать.
+    // Блокировка держится до сохранения индекса, чтобы очистка хранилища в соседней установке
+    // не удалила объекты, на которые пока ссылается только промежуточная папка
+    ContentStore store(job.storePath);
+    const bool useStore = !job.storePath.isEmpty() && store.lockShared();
+
+    qint64 entriesWritten = 0;
+    qint64 entriesReused = 0;
+    qint64 entriesFromStore = 0;
+    bool resumed = false;
+    InstalledIndex installed;
+    for (bool useBaseline = haveBaseline;; useBaseline = false) {
+        ArchiveExtractor extractor(stagingPath);
+        extractor.setCounters(job.counters.get());
+        extractor.setFormat(package.format);
+        extractor.setExpectedDigests(package.archiveSha256, package.entrySha256);
+        extractor.setMemoryBudget(job.memoryBudget);
+        if (job.threadCount > 0) {
+            extractor.setThreadCounts(job.threadCount, job.threadCount);
+        }
+        if (isDelta) {
+            extractor.setDeltaBase(job.basePath, &deltaBase);
         } else {
-            QString errorMsg = QString("Ошибка распаковки '%1'. stderr: %2")
-                                   .arg(package.displayName, QString::fromUtf8(unpacker->readAllStandardError()));
-            emit statusMessage(errorMsg);
-            emit installationFinished(package.displayName, false, errorMsg);
+            extractor.setJournal(&journal, checkpoint);
+        }
+        if (useBaseline) {
+            extractor.setBaseline(targetInstallPath, &baseline);
+        }
+        if (useStore) {
+            extractor.setContentStore(&store);
+        }
+        if (extractor.extract(package.resourcePath)) {
+            entriesWritten = extractor.entriesWritten();
+            entriesReused = extractor.entriesReused();
+            entriesFromStore = extractor.entriesFromStore();
+            resumed = extractor.isResumed();
+            installed = extractor.installedIndex();
+            break;
+        }
+
+        // Отмена и ошибки откатываются полностью; продолжить можно только установку,
+        // прерванную вместе с процессом
+        {
+            PACKMAN_TRACE_SCOPE("cleanup.staging");
+            journal.remove();
+            removeTree(stagingPath);
+        }
+        if (useBaseline && extractor.needsFullExtraction() && !job.counters->isCancelled()) {
+            // Редкий случай: крупный файл изменён без смены размера и времени - повторяем без индекса
+            checkpoint = ExtractionCheckpoint();
+            job.counters->bytesIn.store(0);
+            job.counters->bytesOut.store(0);
+            job.counters->entries.store(0);
+            continue;
+        }
+        if (job.counters->isCancelled()) {
+            *message = QString("Установка '%1' отменена").arg(package.displayName);
+        } else {
+            *message = QString("Ошибка распаковки '%1': %2").arg(package.displayName, extractor.errorString());
         }
+        return false;
+    }
+    journal.remove();
 
-        unpacker->deleteLater();
+    // Перенос на место, индекс и очистка - тоже часть завершения установки
+    PhaseTimer finalizeTimer(job.counters->finalizeNs);
+    // Индекс должен описывать всё дерево: дельта-обновление берёт неизменившиеся файлы по нему,
+    // а хранилище по нему решает, какие объекты ещё нужны. Файлы, записанные до контрольной
+    // точки, и всё, что распаковка не учла, добавляются хэшированием промежуточной папки
+    bool indexComplete = false;
+    {
+        PACKMAN_TRACE_SCOPE("index.complete", installed.size());
+        indexComplete = installed.addMissingFiles(stagingPath);
+    }
+    QString error;
+    const bool replacesPrevious = isDelta || QFileInfo::exists(targetInstallPath);
+    if (!commitStagedInstall(stagingPath, targetInstallPath, &error)) {
+        PACKMAN_TRACE_SCOPE("cleanup.staging");
+        removeTree(stagingPath);
+        *message = QString("Ошибка установки '%1': %2").arg(package.displayName, error);
+        return false;
+    }
+    // Индекс необязателен: без него следующая переустановка просто запишет все файлы.
+    // Неполный индекс хуже отсутствующего - прежний удаляется
+    if (indexComplete) {
+        PACKMAN_TRACE_SCOPE("index.save", installed.size());
+        installed.save(indexPath);
+    } else {
+        QFile::remove(indexPath);
+    }
+    // Обновлённая базовая версия больше не нужна: её неизменившиеся файлы уже связаны с новой
+    if (isDelta) {
+        if (QDir::cleanPath(job.basePath) != QDir::cleanPath(targetInstallPath)) {
+            PACKMAN_TRACE_SCOPE("cleanup.base");
+            removeTree(job.basePath);
+        }
+        QFile::remove(deltaIndexPath);
+    }
+    store.unlock();
+    // После замены версии часть объектов хранилища могла остаться без ссылок. Очистка,
+    // пропущенная из-за параллельной установки, выполняется первой освободившейся
+    if (useStore && (replacesPrevious || store.isPrunePending())) {
+        PACKMAN_TRACE_SCOPE("store.prune");
+        const QDir indexDir(QFileInfo(indexPath).absolutePath());
+        QStringList indexPaths;
+        for (const QString& name : indexDir.entryList(QStringList() << "*.index", QDir::Files)) {
+            indexPaths.append(indexDir.filePath(name));
+        }
+        store.prune(indexPaths);
+    }
 
-        // Очистка временной директории после завершения установки
-        m_tempDir.reset(nullptr);
-    });
+    QString details = QString("записей: %1").arg(entriesWritten);
+    if (entriesReused > 0) {
+        details += QString(", без изменений: %1").arg(entriesReused);
+    }
+    if (entriesFromStore > 0) {
+        details += QString(", из хранилища: %1").arg(entriesFromStore);
+    }
+    *message = QString("Пакет '%1' успешно распакован в '%2' (%3)").arg(package.displayName, targetInstallPath, details);
+    if (resumed) {
+        *message += " - продолжено с контрольной точки";
+    }
+    return true;
+}
+
+bool PackageManager::runPartialInstallJob(const InstallJob& job, QString* message) {
+    PACKMAN_TRACE_SCOPE("install.partial", job.paths.size());
+    const PackageInfo& package = job.package;
+    ArchiveIndex index;
+    QString error;
+    if (!index.load(ArchiveIndex::pathFor(package.resourcePath), &error)) {
+        *message = QString("Частичная установка '%1' недоступна: у архива нет индекса (%2)").arg(package.displayName, error);
+        return false;
+    }
+    const QList<ArchiveEntry> entries = index.select(job.paths);
+    if (entries.isEmpty()) {
+        *message = QString("В пакете '%1' нет путей: %2").arg(package.displayName, job.paths.join(", "));
+        return false;
+    }
 
-    unpacker->start(program, arguments);
+    // Выбранные записи распаковываются в промежуточную папку и проверяются: повреждённый
+    // или обрезанный архив не оставляет в установке наполовину записанных файлов
+    const QString stagingPath = job.targetPath + ".entries";
+    {
+        PACKMAN_TRACE_SCOPE("cleanup.staging");
+        removeTree(stagingPath);
+    }
+    ArchiveExtractor extractor(stagingPath);
+    extractor.setCounters(job.counters.get());
+    extractor.setFormat(package.format);
+    extractor.setExpectedDigests(package.archiveSha256, package.entrySha256);
+    extractor.setMemoryBudget(job.memoryBudget);
+    if (job.threadCount > 0) {
+        extractor.setThreadCounts(job.threadCount, job.threadCount);
+    }
+    bool ok = extractor.extractEntries(package.resourcePath, index, entries);
+    if (!ok) {
+        if (job.counters->isCancelled()) {
+            *message = QString("Установка '%1' отменена").arg(package.displayName);
+        } else {
+            *message = QString("Ошибка распаковки '%1': %2").arg(package.displayName, extractor.errorString());
+        }
+    }
+    // Сверка размеров записанных файлов с индексом архива - даже для файлов без суммы в манифесте
+    for (auto it = entries.constBegin(); ok && it != entries.constEnd(); ++it) {
+        if (it->type != '0' && it->type != '\0' && it->type != '7') {
+            continue;
+        }
+        const QFileInfo written(QDir(stagingPath).filePath(it->path));
+        if (!written.isFile() || written.size() != it->size) {
+            *message = QString("Ошибка распаковки '%1': размер '%2' не совпадает с индексом архива")
+                           .arg(package.displayName, it->path);
+            ok = false;
+        }
+    }
+
+    PhaseTimer finalizeTimer(job.counters->finalizeNs);
+    // Индекс установленных файлов дополняется выбранными; без прежнего индекса новый не создаётся -
+    // он описывал бы только часть дерева
+    const QString indexPath = InstalledIndex::pathFor(QFileInfo(job.targetPath).absolutePath(), package.id);
+    InstalledIndex installed;
+    InstalledIndex added = extractor.installedIndex();
+    bool updateIndex = ok && installed.load(indexPath) && added.addMissingFiles(stagingPath);
+    for (auto it = entries.constBegin(); updateIndex && it != entries.constEnd(); ++it) {
+        // Файл, который заменяется каталогом или символической ссылкой, из индекса не убрать
+        if ((it->type == '2' || it->type == '5') && installed.find(it->path)) {
+            updateIndex = false;
+        }
+    }
+    if (ok && !QDir().mkpath(job.targetPath)) {
+        *message = QString("Ошибка установки '%1': не удалось создать папку '%2'").arg(package.displayName, job.targetPath);
+        ok = false;
+    }
+    if (ok && !moveStagedEntries(stagingPath, job.targetPath, &error)) {
+        // Часть записей уже на месте: индекс больше не соответствует дереву
+        QFile::remove(indexPath);
+        *message = QString("Ошибка установки '%1': %2").arg(package.displayName, error);
+        ok = false;
+    }
+    {
+        PACKMAN_TRACE_SCOPE("cleanup.staging");
+        removeTree(stagingPath);
+    }
+    if (!ok) {
+        return false;
+    }
+    if (updateIndex) {
+        PACKMAN_TRACE_SCOPE("index.save", added.size());
+        const QHash<QString, InstalledFile>& files = added.files();
+        for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+            installed.insert(it.key(), it.value());
+        }
+        installed.save(indexPath);
+    } else {
+        QFile::remove(indexPath);
+    }
+    *message = QString("Из пакета '%1' распаковано в '%2' (записей: %3 из %4)")
+                   .arg(package.displayName, job.targetPath)
+                   .arg(extractor.entriesWritten())
+                   .arg(index.entries().size());
+    return true;
 }
\ No newline at end of file
@@ -1,11 +1,19 @@
 #pragma once
 
+#include "ArchiveIndex.h"
 #include "PackageInfo.h"
+#include "PackageCatalog.h"
+#include "InstallProgress.h"
 
 #include <QObject>
 #include <QList>
-#include <QScopedPointer>
-#include <QTemporaryDir>
+#include <QHash>
+#include <QElapsedTimer>
+
+class QTimer;
+
+struct InstallJob;
+class InstallScheduler;
 
 class PackageManager : public QObject {
     Q_OBJECT
@@ -14,26 +22,88 @@ public:
     explicit PackageManager(QObject *parent = nullptr);
     ~PackageManager();
 
-    // Возвращает список доступных для установки пакетов
-    QList<PackageInfo> getAvailablePackages() const;
+    // Каталог доступных для установки пакетов
+    const PackageCatalog& catalog() const { return m_catalog; }
+    // Пакет по id (O(1)) или nullptr
+    const PackageInfo* findPackage(const QString& id) const;
+
+    // Ставит выбранный пакет в очередь установки. Возвращает id задания (0 - пакет не принят).
+    // Непустой paths - частичная установка: только эти пути архива (файлы или каталоги целиком)
+    // дописываются в папку пакета. Нужен индекс архива (ArchiveIndex), собранный при сборке
+    int installPackage(const PackageInfo& package, const QStringList& paths = QStringList());
+
+    // Содержимое архива пакета: по индексу без распаковки, без индекса - полным проходом
+    bool listContents(const PackageInfo& package, QList<ArchiveEntry>* entries, QString* error);
+
+    // Отмена установки по id задания: ожидающая снимается с очереди, выполняющаяся
+    // прерывается и откатывается (промежуточная папка удаляется, целевая не меняется)
+    bool cancelInstallation(int jobId);
+    void cancelAllInstallations();
 
-    // Начинает установку выбранного пакета
-    void installPackage(const PackageInfo& package);
+    // Ограничение на число одновременно выполняемых установок
+    void setMaxConcurrentInstalls(int count);
+    int maxConcurrentInstalls() const;
+    // Есть ли установки в очереди или в работе
+    bool isBusy() const;
+
+    // Корневая папка установки (по умолчанию ~/MyInstalledApps)
+    void setInstallRoot(const QString& path);
+    QString installRoot() const { return m_installRoot; }
+    // Папка, в которую устанавливается пакет
+    QString installPathFor(const PackageInfo& package) const;
+
+    // Хранилище содержимого в <корень установки>/.packman/store: одинаковые файлы разных
+    // пакетов и версий хранятся один раз, а установки собираются из ссылок на них.
+    // По умолчанию выключено; действует на задания, поставленные после вызова
+    void setContentStoreEnabled(bool enabled) { m_contentStoreEnabled = enabled; }
+    bool isContentStoreEnabled() const { return m_contentStoreEnabled; }
+
+    // Сколько памяти могут занимать буферы распаковки всех одновременных установок вместе
+    // (по умолчанию 256 МБ): каждое задание получает долю по maxConcurrentInstalls().
+    // Так же делятся и ядра: потоков распаковки и записи у задания - idealThreadCount() / maxConcurrentInstalls().
+    // Действует на задания, поставленные после вызова
+    void setMemoryBudget(qint64 bytes) { m_memoryBudget = bytes; }
+    qint64 memoryBudget() const { return m_memoryBudget; }
 
 signals:
     // Сигнал о начале процесса установки
     void installationStarted(const QString& packageName);
     // Сигнал о завершении установки (true - успех, false - ошибка)
     void installationFinished(const QString& packageName, bool success, const QString& message);
+    // Установка отменена, не начавшись (installationStarted для неё не было)
+    void installationCancelled(const QString& packageName, const QString& message);
     // Сигнал для вывода сообщений в лог или статусную строку
     void statusMessage(const QString& message);
+    // Прогресс выполняющейся установки; публикуется не чаще одного раза за тик UI
+    void progressChanged(const InstallProgress& progress);
+    // Сигнал об окончании всех заданий в очереди
+    void allInstallationsFinished();
 
 
 private:
-    // Список пакетов, известных менеджеру
-    QList<PackageInfo> availablePackages; 
+    // Пакеты, известные менеджеру
+    PackageCatalog m_catalog;
 
     // Инициализация списка доступных пакетов
     void loadPackageDefinitions();
-    QScopedPointer<QTemporaryDir> m_tempDir;
+
+    // Тело задания установки, выполняется в рабочем потоке планировщика
+    static bool runInstallJob(const InstallJob& job, QString* message);
+    static bool runPartialInstallJob(const InstallJob& job, QString* message);
+    InstallScheduler* m_scheduler;
+    QString m_installRoot;
+    bool m_contentStoreEnabled = false;
+    qint64 m_memoryBudget = 256 * 1024 * 1024;
+
+    // Опрос счётчиков рабочих потоков по таймеру вместо сигнала на каждую порцию данных
+    struct ProgressSample {
+        qint64 lastBytes = 0;
+        qint64 lastMs = 0;
+        double rate = 0.0;
+    };
+    void publishProgress();
+    InstallProgress sampleProgress(const InstallJob& job);
+    QTimer* m_progressTimer;
+    QElapsedTimer m_progressClock;
+    QHash<int, ProgressSample> m_progressSamples;
 };
\ No newline at end of file
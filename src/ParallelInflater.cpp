@@ -0,0 +1,214 @@
+#include "ParallelInflater.h"
+#include "BufferPool.h"
+#include "FunctionRunnable.h"
+#include "Trace.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+// Сколько сжатых байт разжимает одна задача: блоки BGZF по 64 КБ слишком мелкие
+constexpr qint64 kBatchCompressedSize = 1024 * 1024;
+// Предел распакованного размера группы - это и размер буфера из пула
+constexpr qint64 kBatchOutputSize = 2 * 1024 * 1024;
+
+struct Batch {
+    qint64 begin = 0;
+    qint64 end = 0;
+    qint64 outputSize = 0;
+    char* output = nullptr;
+    std::unique_ptr<char[]> oversized;  // Один член крупнее буфера пула (не бывает у BGZF по спецификации)
+    QString error;
+    bool done = false;
+};
+
+// Размер члена BGZF, начинающегося с data, или 0, если это не BGZF
+qint64 blockMemberSize(const uchar* data, qint64 available) {
+    if (available < 18 || data[0] != 0x1f || data[1] != 0x8b || data[2] != 8 || !(data[3] & 0x04)) {
+        return 0;
+    }
+    const int extraLength = data[10] | (data[11] << 8);
+    if (12 + extraLength > available) {
+        return 0;
+    }
+    int pos = 12;
+    while (pos + 4 <= 12 + extraLength) {
+        const int fieldLength = data[pos + 2] | (data[pos + 3] << 8);
+        if (data[pos] == 'B' && data[pos + 1] == 'C' && fieldLength == 2 && pos + 6 <= 12 + extraLength) {
+            const qint64 memberSize = (data[pos + 4] | (data[pos + 5] << 8)) + 1;
+            return memberSize <= available ? memberSize : 0;
+        }
+        pos += 4 + fieldLength;
+    }
+    return 0;
+}
+
+quint32 readLittleEndian32(const uchar* data) {
+    return quint32(data[0]) | (quint32(data[1]) << 8) | (quint32(data[2]) << 16) | (quint32(data[3]) << 24);
+}
+
+bool splitIntoBatches(const uchar* data, qint64 size, std::vector<Batch>* batches) {
+    Batch current;
+    qint64 pos = 0;
+    while (pos < size) {
+        const qint64 memberSize = blockMemberSize(data + pos, size - pos);
+        if (memberSize == 0) {
+            return false;
+        }
+        const qint64 memberOutput = readLittleEndian32(data + pos + memberSize - 4);
+        if (current.end > current.begin && current.outputSize + memberOutput > kBatchOutputSize) {
+            batches->push_back(std::move(current));
+            current = Batch();
+        }
+        if (current.end == current.begin) {
+            current.begin = pos;
+            current.end = pos;
+        }
+        current.end += memberSize;
+        current.outputSize += memberOutput;
+        pos += memberSize;
+
+        if (current.end - current.begin >= kBatchCompressedSize) {
+            batches->push_back(std::move(current));
+            current = Batch();
+        }
+    }
+    if (current.end > current.begin) {
+        batches->push_back(std::move(current));
+    }
+    return true;
+}
+
+// Разжимает подряд идущие члены gzip в буфер заранее известного размера (проверяя CRC)
+bool inflateMembers(const uchar* data, qint64 size, char* output, qint64 outputSize, QString* error) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        *error = "Не удалось инициализировать zlib";
+        return false;
+    }
+    stream.next_in = const_cast<Bytef*>(data);
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef*>(output);
+    stream.avail_out = static_cast<uInt>(outputSize);
+
+    for (;;) {
+        const int rc = inflate(&stream, Z_NO_FLUSH);
+        if (rc == Z_STREAM_END) {
+            if (stream.avail_in == 0) {
+                break;
+            }
+            inflateReset(&stream);
+            continue;
+        }
+        if (rc != Z_OK) {
+            *error = QString("Архив повреждён: ошибка zlib %1 в блоке BGZF").arg(rc);
+            break;
+        }
+    }
+    if (error->isEmpty() && stream.avail_out != 0) {
+        *error = "Архив повреждён: размер блока BGZF не совпадает с ISIZE";
+    }
+    inflateEnd(&stream);
+    return error->isEmpty();
+}
+
+} // namespace
+
+ParallelInflater::ParallelInflater(int threadCount, qint64 memoryLimit)
+    : m_threadCount(qMax(1, threadCount)), m_memoryLimit(memoryLimit) {}
+
+bool ParallelInflater::isBlockGzip(const uchar* data, qint64 size) {
+    return blockMemberSize(data, size) > 0;
+}
+
+bool ParallelInflater::run(const uchar* data, qint64 size, const Sink& sink) {
+    std::vector<Batch> batches;
+    if (!splitIntoBatches(data, size, &batches)) {
+        m_error = "Архив повреждён: нарушена структура блоков BGZF";
+        return false;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_threadCount);
+    QMutex mutex;
+    QWaitCondition batchReady;
+
+    // Не более двух групп на поток вперёд потребителя и не больше, чем помещается в лимит
+    // памяти. Каждая группа разжимается в буфер из пула, который возвращается после того,
+    // как потребитель её обработал, - новые группы ждут свободного буфера
+    size_t window = static_cast<size_t>(m_threadCount) * 2;
+    if (m_memoryLimit > 0) {
+        window = qBound<size_t>(2, static_cast<size_t>(m_memoryLimit / kBatchOutputSize), window);
+    }
+    BufferPool buffers(kBatchOutputSize, static_cast<int>(window));
+    size_t submitted = 0;
+    bool ok = true;
+
+    for (size_t next = 0; next < batches.size(); ++next) {
+        for (; submitted < batches.size() && submitted < next + window; ++submitted) {
+            Batch* batch = &batches[submitted];
+            if (batch->outputSize <= kBatchOutputSize) {
+                batch->output = buffers.acquire();
+            } else {
+                batch->oversized.reset(new char[static_cast<size_t>(batch->outputSize)]);
+                batch->output = batch->oversized.get();
+            }
+            pool.start(new FunctionRunnable([this, batch, data, &mutex, &batchReady]() {
+                QElapsedTimer timer;
+                timer.start();
+                QString error;
+                {
+                    PACKMAN_TRACE_SCOPE("inflate.batch", batch->outputSize);
+                    inflateMembers(data + batch->begin, batch->end - batch->begin, batch->output, batch->outputSize, &error);
+                }
+                const qint64 elapsed = timer.nsecsElapsed();
+                QMutexLocker lock(&mutex);
+                m_decodeNs += elapsed;
+                batch->error = error;
+                batch->done = true;
+                batchReady.wakeAll();
+            }));
+        }
+
+        Batch& batch = batches[next];
+        const qint64 compressedSize = batch.end - batch.begin;
+        {
+            // Потребитель ждёт очередную группу: длинные ожидания - недостаток потоков распаковки
+            PACKMAN_TRACE_SCOPE("inflate.wait");
+            QMutexLocker lock(&mutex);
+            while (!batch.done) {
+                batchReady.wait(&mutex);
+            }
+            if (!batch.error.isEmpty()) {
+                m_error = batch.error;
+                ok = false;
+                break;
+            }
+        }
+        const bool proceed = sink(batch.output, batch.outputSize, compressedSize);
+        if (batch.oversized) {
+            batch.oversized.reset();
+        } else {
+            buffers.release(batch.output);
+        }
+        batch.output = nullptr;
+        if (!proceed) {
+            break;
+        }
+    }
+
+    // Незапущенные задачи больше не нужны; запущенные обращаются к локальным объектам - дожидаемся
+    pool.clear();
+    pool.waitForDone();
+    return ok;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QString>
+
+#include <functional>
+
+// Параллельная распаковка блочного gzip (BGZF: каждый член gzip хранит свой сжатый
+// размер в поле FEXTRA 'BC', а исходный - в ISIZE). Границы членов находятся без
+// распаковки, поэтому группы блоков разжимаются независимо на нескольких ядрах,
+// а результат отдаётся потребителю строго по порядку.
+class ParallelInflater {
+public:
+    // Получает очередную порцию распакованных данных и объём сжатых данных, из которых
+    // она получена. Возвращает false, чтобы остановить распаковку досрочно
+    using Sink = std::function<bool(const char* data, qint64 size, qint64 compressedSize)>;
+
+    // memoryLimit - сколько памяти могут занимать распакованные, но ещё не отданные
+    // потребителю группы блоков; 0 - без ограничения, кроме окна в два блока на поток
+    explicit ParallelInflater(int threadCount, qint64 memoryLimit = 0);
+
+    // Начинаются ли данные с члена BGZF
+    static bool isBlockGzip(const uchar* data, qint64 size);
+
+    // Распаковывает весь буфер. false - ошибка данных (см. errorString()); остановка
+    // потребителем ошибкой не считается
+    bool run(const uchar* data, qint64 size, const Sink& sink);
+
+    QString errorString() const { return m_error; }
+    // Суммарное время распаковки блоков по всем потокам, нс
+    qint64 decodeNanoseconds() const { return m_decodeNs; }
+
+private:
+    int m_threadCount;
+    qint64 m_memoryLimit;
+    qint64 m_decodeNs = 0;
+    QString m_error;
+};
\ No newline at end of file
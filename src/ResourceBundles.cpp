@@ -0,0 +1,57 @@
+#include "ResourceBundles.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QResource>
+#include <QSet>
+
+namespace {
+
+QMutex g_mutex;
+QString g_searchPath;
+QSet<QString> g_registered;
+
+} // namespace
+
+void ResourceBundles::setSearchPath(const QString& directory) {
+    QMutexLocker lock(&g_mutex);
+    g_searchPath = directory;
+}
+
+QString ResourceBundles::searchPath() {
+    QMutexLocker lock(&g_mutex);
+    return g_searchPath;
+}
+
+QString ResourceBundles::resolve(const QString& bundleFile) {
+    if (bundleFile.isEmpty() || QDir::isAbsolutePath(bundleFile)) {
+        return bundleFile;
+    }
+    return QDir(searchPath()).filePath(bundleFile);
+}
+
+bool ResourceBundles::ensureRegistered(const QString& bundleFile, QString* error) {
+    if (bundleFile.isEmpty()) {
+        return true;
+    }
+    const QString path = QDir::cleanPath(resolve(bundleFile));
+
+    QMutexLocker lock(&g_mutex);
+    if (g_registered.contains(path)) {
+        return true;
+    }
+    if (!QFileInfo::exists(path)) {
+        return true;
+    }
+    // Qt отображает .rcc в память и читает данные ресурсов прямо из отображения
+    if (!QResource::registerResource(path)) {
+        if (error) {
+            *error = QString("Не удалось зарегистрировать бандл ресурсов '%1'").arg(path);
+        }
+        return false;
+    }
+    g_registered.insert(path);
+    return true;
+}
\ No newline at end of file
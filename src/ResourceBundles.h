@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QString>
+
+// Реестр внешних бандлов ресурсов (.rcc с архивами пакетов).
+// Бандл регистрируется через QResource::registerResource только при первом обращении
+// к пакету из него; Qt отображает файл в память (mmap), поэтому ни размер бинарника,
+// ни время запуска, ни резидентная память не зависят от числа поставляемых архивов.
+// Потокобезопасен.
+class ResourceBundles {
+public:
+    // Папка, относительно которой ищутся бандлы с относительными именами
+    static void setSearchPath(const QString& directory);
+    static QString searchPath();
+
+    // Регистрирует бандл, если он ещё не зарегистрирован. Пустое имя - ресурс встроен в бинарник.
+    // Отсутствие файла ошибкой не считается: ресурс может быть встроен сборкой
+    // (PACKMAN_EMBED_PACKAGES), тогда проверку выполнит вызывающий код по пути ресурса.
+    static bool ensureRegistered(const QString& bundleFile, QString* error = nullptr);
+
+    // Путь к файлу бандла с учётом папки поиска
+    static QString resolve(const QString& bundleFile);
+
+private:
+    ResourceBundles() = delete;
+};
\ No newline at end of file
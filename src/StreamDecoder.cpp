@@ -0,0 +1,280 @@
+#include "StreamDecoder.h"
+
+#include <cstring>
+#include <zlib.h>
+
+#ifdef PACKMAN_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef PACKMAN_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+namespace {
+
+// Вход и выход передаются библиотекам порциями: у zlib счётчики имеют тип uInt
+constexpr qint64 kMaxSlice = 64 * 1024 * 1024;
+
+bool hasMagic(const uchar* data, qint64 size, const uchar* magic, int length) {
+    return size >= length && std::memcmp(data, magic, static_cast<size_t>(length)) == 0;
+}
+
+const uchar kGzipMagic[] = {0x1f, 0x8b};
+const uchar kZstdMagic[] = {0x28, 0xb5, 0x2f, 0xfd};
+const uchar kXzMagic[] = {0xfd, '7', 'z', 'X', 'Z', 0x00};
+
+class GzipDecoder : public StreamDecoder {
+public:
+    GzipDecoder() {
+        std::memset(&m_stream, 0, sizeof(m_stream));
+        // 15 + 32: автоопределение заголовка gzip/zlib
+        m_ready = inflateInit2(&m_stream, 15 + 32) == Z_OK;
+        if (!m_ready) {
+            m_error = "Не удалось инициализировать zlib";
+        }
+    }
+    ~GzipDecoder() override {
+        if (m_ready) {
+            inflateEnd(&m_stream);
+        }
+    }
+
+    bool isReady() const { return m_ready; }
+
+    Status decode(const uchar* in, qint64 inSize, qint64* consumed, char* out, qint64 outSize, qint64* produced) override {
+        m_stream.next_in = const_cast<Bytef*>(in);
+        m_stream.avail_in = static_cast<uInt>(qMin(inSize, kMaxSlice));
+        m_stream.next_out = reinterpret_cast<Bytef*>(out);
+        m_stream.avail_out = static_cast<uInt>(qMin(outSize, kMaxSlice));
+        const uInt availIn = m_stream.avail_in;
+        const uInt availOut = m_stream.avail_out;
+
+        const int rc = inflate(&m_stream, Z_NO_FLUSH);
+        *consumed = availIn - m_stream.avail_in;
+        *produced = availOut - m_stream.avail_out;
+        if (rc == Z_STREAM_END) {
+            return Status::StreamEnd;
+        }
+        if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            m_error = QString("ошибка zlib %1 (%2)").arg(rc).arg(QString::fromLatin1(m_stream.msg ? m_stream.msg : ""));
+            return Status::Error;
+        }
+        return Status::Ok;
+    }
+
+    bool reset() override { return inflateReset(&m_stream) == Z_OK; }
+
+    bool startsMember(const uchar* data, qint64 size) const override {
+        return hasMagic(data, size, kGzipMagic, sizeof(kGzipMagic));
+    }
+
+private:
+    z_stream m_stream;
+    bool m_ready = false;
+};
+
+#ifdef PACKMAN_HAVE_ZSTD
+class ZstdDecoder : public StreamDecoder {
+public:
+    ZstdDecoder() : m_stream(ZSTD_createDStream()) {
+        if (!m_stream) {
+            m_error = "Не удалось инициализировать zstd";
+        }
+    }
+    ~ZstdDecoder() override { ZSTD_freeDStream(m_stream); }
+
+    bool isReady() const { return m_stream != nullptr; }
+
+    Status decode(const uchar* in, qint64 inSize, qint64* consumed, char* out, qint64 outSize, qint64* produced) override {
+        ZSTD_inBuffer input = {in, static_cast<size_t>(inSize), 0};
+        ZSTD_outBuffer output = {out, static_cast<size_t>(outSize), 0};
+        const size_t rc = ZSTD_decompressStream(m_stream, &output, &input);
+        *consumed = static_cast<qint64>(input.pos);
+        *produced = static_cast<qint64>(output.pos);
+        if (ZSTD_isError(rc)) {
+            m_error = QString("ошибка zstd: %1").arg(QString::fromLatin1(ZSTD_getErrorName(rc)));
+            return Status::Error;
+        }
+        // 0 - кадр полностью декодирован и выход сброшен
+        return rc == 0 ? Status::StreamEnd : Status::Ok;
+    }
+
+    bool reset() override { return !ZSTD_isError(ZSTD_DCtx_reset(m_stream, ZSTD_reset_session_only)); }
+
+    bool startsMember(const uchar* data, qint64 size) const override {
+        return hasMagic(data, size, kZstdMagic, sizeof(kZstdMagic));
+    }
+
+private:
+    ZSTD_DStream* m_stream;
+};
+#endif
+
+#ifdef PACKMAN_HAVE_LZMA
+class XzDecoder : public StreamDecoder {
+public:
+    XzDecoder() { m_ready = init(); }
+    ~XzDecoder() override { lzma_end(&m_stream); }
+
+    bool isReady() const { return m_ready; }
+
+    Status decode(const uchar* in, qint64 inSize, qint64* consumed, char* out, qint64 outSize, qint64* produced) override {
+        m_stream.next_in = in;
+        m_stream.avail_in = static_cast<size_t>(inSize);
+        m_stream.next_out = reinterpret_cast<uint8_t*>(out);
+        m_stream.avail_out = static_cast<size_t>(outSize);
+
+        const lzma_ret rc = lzma_code(&m_stream, LZMA_RUN);
+        *consumed = inSize - static_cast<qint64>(m_stream.avail_in);
+        *produced = outSize - static_cast<qint64>(m_stream.avail_out);
+        if (rc == LZMA_STREAM_END) {
+            return Status::StreamEnd;
+        }
+        if (rc != LZMA_OK && rc != LZMA_BUF_ERROR) {
+            m_error = QString("ошибка xz %1").arg(static_cast<int>(rc));
+            return Status::Error;
+        }
+        return Status::Ok;
+    }
+
+    bool reset() override {
+        lzma_end(&m_stream);
+        return init();
+    }
+
+    bool startsMember(const uchar* data, qint64 size) const override {
+        return hasMagic(data, size, kXzMagic, sizeof(kXzMagic));
+    }
+
+private:
+    bool init() {
+        m_stream = LZMA_STREAM_INIT;
+        if (lzma_stream_decoder(&m_stream, UINT64_MAX, 0) != LZMA_OK) {
+            m_error = "Не удалось инициализировать liblzma";
+            return false;
+        }
+        return true;
+    }
+
+    lzma_stream m_stream = LZMA_STREAM_INIT;
+    bool m_ready = false;
+};
+#endif
+
+// Несжатый tar: байты передаются как есть
+class PlainDecoder : public StreamDecoder {
+public:
+    Status decode(const uchar* in, qint64 inSize, qint64* consumed, char* out, qint64 outSize, qint64* produced) override {
+        const qint64 count = qMin(inSize, outSize);
+        std::memcpy(out, in, static_cast<size_t>(count));
+        *consumed = count;
+        *produced = count;
+        return Status::Ok;
+    }
+    bool reset() override { return true; }
+    bool startsMember(const uchar*, qint64) const override { return false; }
+};
+
+template <typename Decoder>
+std::unique_ptr<StreamDecoder> makeDecoder(QString* error) {
+    std::unique_ptr<Decoder> decoder(new Decoder);
+    if (!decoder->isReady()) {
+        if (error) { *error = decoder->errorString(); }
+        return nullptr;
+    }
+    return std::unique_ptr<StreamDecoder>(decoder.release());
+}
+
+} // namespace
+
+ArchiveFormat StreamDecoder::detect(const uchar* data, qint64 size) {
+    if (hasMagic(data, size, kGzipMagic, sizeof(kGzipMagic))) {
+        return ArchiveFormat::Gzip;
+    }
+    if (hasMagic(data, size, kZstdMagic, sizeof(kZstdMagic))) {
+        return ArchiveFormat::Zstd;
+    }
+    if (hasMagic(data, size, kXzMagic, sizeof(kXzMagic))) {
+        return ArchiveFormat::Xz;
+    }
+    // Несжатый tar: "ustar" по смещению 257 первого заголовка
+    if (size >= 262 && std::memcmp(data + 257, "ustar", 5) == 0) {
+        return ArchiveFormat::Tar;
+    }
+    return ArchiveFormat::Auto;
+}
+
+bool StreamDecoder::isSupported(ArchiveFormat format) {
+    switch (format) {
+    case ArchiveFormat::Auto:
+    case ArchiveFormat::Gzip:
+    case ArchiveFormat::Tar:
+        return true;
+    case ArchiveFormat::Zstd:
+#ifdef PACKMAN_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    case ArchiveFormat::Xz:
+#ifdef PACKMAN_HAVE_LZMA
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+QString StreamDecoder::formatName(ArchiveFormat format) {
+    switch (format) {
+    case ArchiveFormat::Auto: return "auto";
+    case ArchiveFormat::Gzip: return "gzip";
+    case ArchiveFormat::Zstd: return "zstd";
+    case ArchiveFormat::Xz: return "xz";
+    case ArchiveFormat::Tar: return "tar";
+    }
+    return QString();
+}
+
+ArchiveFormat StreamDecoder::formatFromName(const QString& name) {
+    const QString lower = name.toLower();
+    if (lower == "gzip" || lower == "gz") { return ArchiveFormat::Gzip; }
+    if (lower == "zstd" || lower == "zst") { return ArchiveFormat::Zstd; }
+    if (lower == "xz") { return ArchiveFormat::Xz; }
+    if (lower == "tar") { return ArchiveFormat::Tar; }
+    return ArchiveFormat::Auto;
+}
+
+std::unique_ptr<StreamDecoder> StreamDecoder::create(ArchiveFormat format, const uchar* data, qint64 size, QString* error) {
+    if (format == ArchiveFormat::Auto) {
+        format = detect(data, size);
+        if (format == ArchiveFormat::Auto) {
+            if (error) { *error = "Неизвестный формат архива"; }
+            return nullptr;
+        }
+    }
+    if (!isSupported(format)) {
+        if (error) { *error = QString("Формат '%1' не поддерживается этой сборкой").arg(formatName(format)); }
+        return nullptr;
+    }
+
+    switch (format) {
+    case ArchiveFormat::Gzip:
+        return makeDecoder<GzipDecoder>(error);
+#ifdef PACKMAN_HAVE_ZSTD
+    case ArchiveFormat::Zstd:
+        return makeDecoder<ZstdDecoder>(error);
+#endif
+#ifdef PACKMAN_HAVE_LZMA
+    case ArchiveFormat::Xz:
+        return makeDecoder<XzDecoder>(error);
+#endif
+    case ArchiveFormat::Tar:
+        return std::unique_ptr<StreamDecoder>(new PlainDecoder);
+    default:
+        break;
+    }
+    if (error) { *error = QString("Формат '%1' не поддерживается этой сборкой").arg(formatName(format)); }
+    return nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "PackageInfo.h"
+
+#include <QString>
+
+#include <memory>
+
+// Подключаемый декодер сжатого потока для ArchiveExtractor.
+// Реализации: gzip (zlib), zstd (libzstd), xz (liblzma) и несжатый tar.
+// zstd и xz доступны, если сборка нашла соответствующие библиотеки
+// (PACKMAN_HAVE_ZSTD / PACKMAN_HAVE_LZMA).
+class StreamDecoder {
+public:
+    enum class Status {
+        Ok,        // Вход использован и/или выход записан, поток продолжается
+        StreamEnd, // Закончился член gzip / кадр zstd / поток xz
+        Error
+    };
+
+    virtual ~StreamDecoder() = default;
+
+    // Декодирует порцию входа в буфер out. *consumed - сколько байт входа использовано,
+    // *produced - сколько байт записано в out
+    virtual Status decode(const uchar* in, qint64 inSize, qint64* consumed,
+                          char* out, qint64 outSize, qint64* produced) = 0;
+    // Подготовка к следующему члену/кадру того же формата (многочленные архивы)
+    virtual bool reset() = 0;
+    // Начинается ли с data следующий член/кадр этого формата
+    virtual bool startsMember(const uchar* data, qint64 size) const = 0;
+
+    QString errorString() const { return m_error; }
+
+    // Декодер для формата; Auto определяется по первым байтам data
+    static std::unique_ptr<StreamDecoder> create(ArchiveFormat format, const uchar* data, qint64 size, QString* error);
+    // Формат по сигнатуре
+    static ArchiveFormat detect(const uchar* data, qint64 size);
+    static bool isSupported(ArchiveFormat format);
+    static QString formatName(ArchiveFormat format);
+    static ArchiveFormat formatFromName(const QString& name);
+
+protected:
+    QString m_error;
+};
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "TarFormat.h"
+
+#include <cstring>
+
+namespace TarFormat {
+
+qint64 parseNumeric(const char* field, int length) {
+    const unsigned char first = static_cast<unsigned char>(field[0]);
+    if (first & 0x80) {
+        qint64 value = first & 0x7f;
+        for (int i = 1; i < length; ++i) {
+            value = (value << 8) | static_cast<unsigned char>(field[i]);
+        }
+        return value;
+    }
+
+    qint64 value = 0;
+    int i = 0;
+    while (i < length && field[i] == ' ') { ++i; }
+    for (; i < length && field[i] >= '0' && field[i] <= '7'; ++i) {
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+QString fieldString(const char* field, int length) {
+    return QString::fromUtf8(field, static_cast<int>(qstrnlen(field, static_cast<uint>(length))));
+}
+
+bool isZeroBlock(const char* block) {
+    for (int i = 0; i < kBlockSize; ++i) {
+        if (block[i] != 0) { return false; }
+    }
+    return true;
+}
+
+bool verifyChecksum(const char* header) {
+    const qint64 stored = parseNumeric(header + 148, 8);
+    qint64 sum = 0;
+    for (int i = 0; i < kBlockSize; ++i) {
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+    }
+    return sum == stored;
+}
+
+QString headerPath(const char* header) {
+    const QString name = fieldString(header, 100);
+    // Формат ustar: префикс пути хранится отдельно
+    if (std::memcmp(header + 257, "ustar", 5) == 0 && header[345] != 0) {
+        return fieldString(header + 345, 155) + '/' + name;
+    }
+    return name;
+}
+
+void parsePaxRecords(const QByteArray& records, QString* path, QString* linkPath) {
+    // Длина записи включает саму себя
+    int pos = 0;
+    while (pos < records.size()) {
+        const int space = records.indexOf(' ', pos);
+        if (space < 0) { break; }
+        const int length = records.mid(pos, space - pos).toInt();
+        if (length <= 0 || pos + length > records.size()) { break; }
+
+        const QByteArray record = records.mid(space + 1, pos + length - space - 2);
+        const int eq = record.indexOf('=');
+        if (eq > 0) {
+            const QByteArray key = record.left(eq);
+            if (key == "path") {
+                *path = QString::fromUtf8(record.mid(eq + 1));
+            } else if (key == "linkpath") {
+                *linkPath = QString::fromUtf8(record.mid(eq + 1));
+            }
+        }
+        pos += length;
+    }
+}
+
+} // namespace TarFormat
\ No newline at end of file
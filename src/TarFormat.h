@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+// Разбор заголовков tar (ustar, расширения GNU и pax): общие функции распаковщика
+// и построителя индекса архива
+namespace TarFormat {
+
+constexpr int kBlockSize = 512;
+
+// Числовые поля: восьмеричная строка или base-256 (расширение GNU для больших значений)
+qint64 parseNumeric(const char* field, int length);
+QString fieldString(const char* field, int length);
+bool isZeroBlock(const char* block);
+bool verifyChecksum(const char* header);
+// Путь из заголовка с учётом префикса ustar
+QString headerPath(const char* header);
+// Записи pax "<длина> <ключ>=<значение>\n": path и linkpath (остальные ключи пропускаются)
+void parsePaxRecords(const QByteArray& records, QString* path, QString* linkPath);
+
+} // namespace TarFormat
\ No newline at end of file
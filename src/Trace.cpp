@@ -0,0 +1,220 @@
+#include "Trace.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Слот кольцевого буфера. sequence - seqlock с номером события: 2 * номер + 1, пока слот
+// пишется, 2 * номер + 2 - после записи. Читатель берёт событие, только если sequence до и
+// после копирования равна ожидаемой: так отбрасываются и недописанные, и перезаписанные слоты
+struct TraceEvent {
+    std::atomic<quint64> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<qint64> start{0};
+    std::atomic<qint64> duration{0};
+    std::atomic<qint64> value{0};
+    std::atomic<int> thread{0};
+};
+
+// Кольцевой буфер одного потока: пишет только владелец, читает снимок любой поток.
+// После завершения потока буфер переходит к следующему новому потоку - пулы
+// распаковщика создают и завершают потоки на каждую установку
+struct ThreadBuffer {
+    std::atomic<quint64> head{0};
+    // Поколение трассировки, к которому относятся события буфера (см. Trace::clear())
+    std::atomic<quint64> generation{0};
+    std::atomic<bool> inUse{true};
+    int thread = 0;
+    TraceEvent events[Trace::kEventsPerThread];
+};
+
+struct Registry {
+    QMutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    int nextThread = 1;
+    QString outputPath;
+    QElapsedTimer clock;
+    // Увеличивается при clear(): буфер прошлого поколения поток обнуляет при следующей записи,
+    // а снимок его пропускает
+    std::atomic<quint64> generation{0};
+
+    Registry() { clock.start(); }
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer* acquireBuffer() {
+    Registry& r = registry();
+    QMutexLocker lock(&r.mutex);
+    ThreadBuffer* buffer = nullptr;
+    for (const auto& candidate : r.buffers) {
+        bool expected = false;
+        if (candidate->inUse.compare_exchange_strong(expected, true)) {
+            buffer = candidate.get();
+            break;
+        }
+    }
+    if (!buffer) {
+        r.buffers.emplace_back(new ThreadBuffer);
+        buffer = r.buffers.back().get();
+    }
+    buffer->thread = r.nextThread++;
+    return buffer;
+}
+
+// Буфер привязывается к потоку при первом событии и освобождается при его завершении
+struct ThreadSlot {
+    ThreadBuffer* buffer = nullptr;
+    ~ThreadSlot() {
+        if (buffer) {
+            buffer->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadSlot t_slot;
+
+void appendNumber(QByteArray* out, double value) {
+    out->append(QByteArray::number(value, 'f', 3));
+}
+
+} // namespace
+
+std::atomic<bool> Trace::s_enabled{false};
+
+void Trace::setEnabled(bool enabled) {
+    // Часы запускаются вместе с реестром, до первого события
+    registry();
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Trace::requestOutput(const QString& outputPath) {
+    {
+        Registry& r = registry();
+        QMutexLocker lock(&r.mutex);
+        r.outputPath = outputPath;
+    }
+    setEnabled(!outputPath.isEmpty());
+}
+
+void Trace::configureFromEnvironment() {
+    const QString path = QString::fromLocal8Bit(qgetenv("PACKMAN_TRACE"));
+    if (!path.isEmpty()) {
+        requestOutput(path);
+    }
+}
+
+bool Trace::writeRequested(QString* error) {
+    QString path;
+    {
+        Registry& r = registry();
+        QMutexLocker lock(&r.mutex);
+        path = r.outputPath;
+    }
+    return path.isEmpty() || writeChromeJson(path, error);
+}
+
+qint64 Trace::now() {
+    return registry().clock.nsecsElapsed();
+}
+
+void Trace::record(const char* name, qint64 startNs, qint64 durationNs, qint64 value) {
+    if (!t_slot.buffer) {
+        t_slot.buffer = acquireBuffer();
+    }
+    ThreadBuffer* buffer = t_slot.buffer;
+    const quint64 generation = registry().generation.load(std::memory_order_acquire);
+    if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+        // Сначала head, потом поколение: снимок, увидевший новое поколение, видит и новый head
+        buffer->head.store(0, std::memory_order_release);
+        buffer->generation.store(generation, std::memory_order_release);
+    }
+    const quint64 head = buffer->head.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[head % kEventsPerThread];
+    event.sequence.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(startNs, std::memory_order_relaxed);
+    event.duration.store(durationNs, std::memory_order_relaxed);
+    event.value.store(value, std::memory_order_relaxed);
+    event.thread.store(buffer->thread, std::memory_order_relaxed);
+    event.sequence.store(2 * head + 2, std::memory_order_release);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::clear() {
+    Registry& r = registry();
+    QMutexLocker lock(&r.mutex);
+    r.generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+QByteArray Trace::toChromeJson() {
+    Registry& r = registry();
+    QMutexLocker lock(&r.mutex);
+
+    QByteArray out;
+    out.reserve(1024 * 1024);
+    out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    out.append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"packman\"}}");
+    const quint64 generation = r.generation.load(std::memory_order_acquire);
+    for (const auto& buffer : r.buffers) {
+        // События до последнего clear(), которые поток ещё не успел отбросить
+        if (buffer->generation.load(std::memory_order_acquire) != generation) {
+            continue;
+        }
+        const quint64 head = buffer->head.load(std::memory_order_acquire);
+        const quint64 available = qMin<quint64>(head, kEventsPerThread);
+        for (quint64 i = head - available; i < head; ++i) {
+            const TraceEvent& slot = buffer->events[i % kEventsPerThread];
+            const quint64 expected = 2 * i + 2;
+            if (slot.sequence.load(std::memory_order_acquire) != expected) {
+                continue;
+            }
+            const char* name = slot.name.load(std::memory_order_relaxed);
+            const qint64 start = slot.start.load(std::memory_order_relaxed);
+            const qint64 duration = slot.duration.load(std::memory_order_relaxed);
+            const qint64 value = slot.value.load(std::memory_order_relaxed);
+            const int thread = slot.thread.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // Слот перезаписали, пока его копировали
+            if (slot.sequence.load(std::memory_order_relaxed) != expected || !name) {
+                continue;
+            }
+            out.append(",{\"name\":\"").append(name).append("\",\"cat\":\"install\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+            out.append(QByteArray::number(thread)).append(",\"ts\":");
+            appendNumber(&out, start / 1000.0);
+            out.append(",\"dur\":");
+            appendNumber(&out, duration / 1000.0);
+            if (value != 0) {
+                out.append(",\"args\":{\"value\":").append(QByteArray::number(value)).append('}');
+            }
+            out.append('}');
+        }
+    }
+    out.append("]}");
+    return out;
+}
+
+bool Trace::writeChromeJson(const QString& path, QString* error) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    file.write(toChromeJson());
+    if (!file.commit()) {
+        if (error) { *error = file.errorString(); }
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+
+// Трассировка конвейера установки: интервалы (начало, длительность) по этапам с разбивкой
+// по потокам. Каждый поток пишет в свой кольцевой буфер без блокировок; снимок всех буферов
+// выгружается в формате Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+// Выключенная трассировка стоит одной атомарной загрузки на интервал, поэтому она собрана
+// всегда и включается во время работы: переменной окружения PACKMAN_TRACE=<файл>,
+// ключом --trace в CLI или сочетанием Ctrl+Shift+T в окне установщика.
+// Буфер потока хранит последние kEventsPerThread событий; старые перезаписываются.
+class Trace {
+public:
+    static constexpr int kEventsPerThread = 1 << 15;
+
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    // Включает трассировку с выгрузкой в outputPath по writeRequested()
+    static void requestOutput(const QString& outputPath);
+    // PACKMAN_TRACE=<файл> - то же, что requestOutput(<файл>)
+    static void configureFromEnvironment();
+    // Выгружает трассировку в файл, заданный requestOutput(); без него ничего не делает
+    static bool writeRequested(QString* error = nullptr);
+
+    // Снимок буферов в Chrome trace JSON. Потоки не останавливаются: событие, которое
+    // перезаписывается во время снимка, в него не попадает
+    static QByteArray toChromeJson();
+    static bool writeChromeJson(const QString& path, QString* error = nullptr);
+    // Отбрасывает все записанные события, в том числе в буферах работающих потоков
+    static void clear();
+
+    // Время от запуска трассировки, нс
+    static qint64 now();
+    // name - строковый литерал: сохраняется только указатель. value - необязательная
+    // величина интервала (байты, число записей), 0 - нет
+    static void record(const char* name, qint64 startNs, qint64 durationNs, qint64 value = 0);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// Интервал трассировки от создания до разрушения объекта
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, qint64 value = 0)
+        : m_name(Trace::isEnabled() ? name : nullptr), m_value(value) {
+        if (m_name) {
+            m_start = Trace::now();
+        }
+    }
+    ~TraceScope() {
+        if (m_name) {
+            Trace::record(m_name, m_start, Trace::now() - m_start, m_value);
+        }
+    }
+
+    // Величина становится известна по ходу интервала
+    void setValue(qint64 value) { m_value = value; }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    qint64 m_value;
+    qint64 m_start = 0;
+};
+
+#define PACKMAN_TRACE_CONCAT_INNER(a, b) a##b
+#define PACKMAN_TRACE_CONCAT(a, b) PACKMAN_TRACE_CONCAT_INNER(a, b)
+
+// Интервал до конца текущей области видимости: PACKMAN_TRACE_SCOPE("decode") или с величиной
+#define PACKMAN_TRACE_SCOPE(...) TraceScope PACKMAN_TRACE_CONCAT(packmanTraceScope, __LINE__)(__VA_ARGS__)
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "ArchiveExtractor.h"
+#include "ArchiveWriter.h"
+#include "DeltaPackage.h"
+#include "InstalledIndex.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+
+using FileTree = QMap<QString, QByteArray>;
+
+QByteArray randomBytes(quint32 seed, int size) {
+    QRandomGenerator random(seed);
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        data[i] = static_cast<char>(random.bounded(256));
+    }
+    return data;
+}
+
+bool writeTree(const QString& root, const FileTree& files) {
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        const QString path = QDir(root).filePath(it.key());
+        QFile file(path);
+        if (!QDir().mkpath(QFileInfo(path).absolutePath()) || !file.open(QIODevice::WriteOnly) ||
+            file.write(it.value()) != it.value().size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Установленная версия: распаковка tar.gz с теми же файлами, как при обычной установке
+bool installTree(const FileTree& files, const QString& archivePath, const QString& installDir, InstalledIndex* index) {
+    QFile file(archivePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    GzipWriter gzip(&file);
+    TarWriter tar([&gzip](const char* data, qint64 size) { return gzip.write(data, size); });
+    bool ok = true;
+    for (auto it = files.constBegin(); ok && it != files.constEnd(); ++it) {
+        ok = tar.addFile(it.key(), it.value());
+    }
+    ok = ok && tar.finish() && gzip.finish();
+    file.close();
+
+    ArchiveExtractor extractor(installDir);
+    if (!ok || !extractor.extract(archivePath)) {
+        return false;
+    }
+    *index = extractor.installedIndex();
+    return index->addMissingFiles(installDir);
+}
+
+FileTree readTree(const QString& root) {
+    FileTree files;
+    for (QDirIterator it(root, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories); it.hasNext();) {
+        QFile file(it.next());
+        if (file.open(QIODevice::ReadOnly)) {
+            files.insert(QDir(root).relativeFilePath(file.fileName()), file.readAll());
+        }
+    }
+    return files;
+}
+
+} // namespace
+
+// Дельта-пакет: патч на уровне байтов и полный цикл "сборка - установка поверх базовой версии"
+class DeltaPackageTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void patchRoundTrip_data();
+    void patchRoundTrip();
+    void patchRejectsOversizedTarget();
+    void deltaInstallRoundTrip();
+};
+
+void DeltaPackageTest::patchRoundTrip_data() {
+    QTest::addColumn<QByteArray>("base");
+    QTest::addColumn<QByteArray>("target");
+
+    const QByteArray base = randomBytes(1, 256 * 1024);
+    QByteArray edited = base;
+    edited.replace(1000, 300, randomBytes(2, 500));
+    edited.insert(100 * 1024, randomBytes(3, 4096));
+    edited.remove(200 * 1024, 8192);
+
+    QTest::newRow("edited") << base << edited;
+    QTest::newRow("identical") << base << base;
+    QTest::newRow("empty base") << QByteArray() << randomBytes(4, 10000);
+    QTest::newRow("empty target") << base << QByteArray();
+    QTest::newRow("unrelated") << base << randomBytes(5, 64 * 1024);
+}
+
+void DeltaPackageTest::patchRoundTrip() {
+    QFETCH(QByteArray, base);
+    QFETCH(QByteArray, target);
+
+    const QByteArray patch = BinaryPatch::diff(base.constData(), base.size(), target.constData(), target.size());
+    QByteArray result;
+    QString error;
+    QVERIFY2(BinaryPatch::apply(base.constData(), base.size(), patch, &result, &error), qPrintable(error));
+    QCOMPARE(result, target);
+}
+
+void DeltaPackageTest::patchRejectsOversizedTarget() {
+    const QByteArray base = randomBytes(6, 64 * 1024);
+    const QByteArray target = base + randomBytes(7, 64 * 1024);
+    const QByteArray patch = BinaryPatch::diff(base.constData(), base.size(), target.constData(), target.size());
+    QByteArray result;
+    QString error;
+    QVERIFY(!BinaryPatch::apply(base.constData(), base.size(), patch, &result, &error, 100 * 1024));
+    QVERIFY(!error.isEmpty());
+}
+
+void DeltaPackageTest::deltaInstallRoundTrip() {
+    QTemporaryDir temp;
+    QVERIFY(temp.isValid());
+    const QDir dir(temp.path());
+
+    FileTree baseFiles;
+    baseFiles.insert("README", "version 1\n");
+    baseFiles.insert("bin/tool", randomBytes(10, 300 * 1024));
+    baseFiles.insert("lib/unchanged.so", randomBytes(11, 200 * 1024));
+    baseFiles.insert("share/removed.txt", "obsolete\n");
+
+    FileTree targetFiles = baseFiles;
+    targetFiles["README"] = "version 2\n";
+    targetFiles["bin/tool"].replace(50 * 1024, 1024, randomBytes(12, 2048));
+    targetFiles.remove("share/removed.txt");
+    targetFiles.insert("share/added.txt", "new file\n");
+
+    // Распакованные версии, по которым собирается дельта
+    QVERIFY(writeTree(dir.filePath("base-src"), baseFiles));
+    QVERIFY(writeTree(dir.filePath("target-src"), targetFiles));
+    DeltaBuilder::Stats stats;
+    QString error;
+    QVERIFY2(DeltaBuilder::build(dir.filePath("base-src"), dir.filePath("target-src"), dir.filePath("delta.tar.gz"),
+                                 &stats, &error),
+             qPrintable(error));
+    QCOMPARE(stats.unchanged, 1);
+    QCOMPARE(stats.patched, 1);
+    QCOMPARE(stats.removed, 1);
+
+    InstalledIndex baseIndex;
+    QVERIFY(installTree(baseFiles, dir.filePath("base.tar.gz"), dir.filePath("base"), &baseIndex));
+
+    ArchiveExtractor extractor(dir.filePath("updated"));
+    extractor.setDeltaBase(dir.filePath("base"), &baseIndex);
+    QVERIFY2(extractor.extract(dir.filePath("delta.tar.gz")), qPrintable(extractor.errorString()));
+
+    QCOMPARE(readTree(dir.filePath("updated")), targetFiles);
+    // Индекс новой версии описывает все её файлы, включая взятые из базовой без изменений
+    const InstalledIndex& updatedIndex = extractor.installedIndex();
+    QCOMPARE(updatedIndex.size(), targetFiles.size());
+    for (auto it = targetFiles.constBegin(); it != targetFiles.constEnd(); ++it) {
+        const InstalledFile* file = updatedIndex.find(it.key());
+        QVERIFY2(file, qPrintable(it.key()));
+        QCOMPARE(file->sha256, QCryptographicHash::hash(it.value(), QCryptographicHash::Sha256));
+    }
+}
+
+QTEST_GUILESS_MAIN(DeltaPackageTest)
+
+#include "DeltaPackageTest.moc"
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "ArchiveExtractor.h"
+#include "ArchiveWriter.h"
+#include "ExtractionJournal.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+
+// Контрольная точка пишется не чаще, чем через 64 МБ tar: архив должен быть больше
+constexpr int kFileCount = 80;
+constexpr int kFileSize = 1024 * 1024;
+
+QString fileName(int i) {
+    return QString("data/file%1.bin").arg(i, 3, 10, QChar('0'));
+}
+
+// Сжимаемое, но у каждого файла своё содержимое
+QByteArray fileContent(int i) {
+    QByteArray block(4096, Qt::Uninitialized);
+    for (int j = 0; j < block.size(); ++j) {
+        block[j] = static_cast<char>((i * 31 + j * 7) & 0xff);
+    }
+    return block.repeated(kFileSize / block.size());
+}
+
+QByteArray readFile(const QString& path) {
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+} // namespace
+
+// Продолжение распаковки, прерванной вместе с процессом, с контрольной точки журнала
+class ExtractionResumeTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void resumeFromCheckpoint_data();
+    void resumeFromCheckpoint();
+    void checkpointOfOtherArchiveIsIgnored();
+    void fingerprintDistinguishesSameSizeArchives();
+
+private:
+    QTemporaryDir m_temp;
+    QString m_archivePath;
+};
+
+void ExtractionResumeTest::initTestCase() {
+    QVERIFY(m_temp.isValid());
+    m_archivePath = QDir(m_temp.path()).filePath("package.tar.gz");
+    QFile file(m_archivePath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    // BGZF: точки перезапуска есть в начале каждого блока
+    BgzfWriter bgzf(&file, 1);
+    TarWriter tar([&bgzf](const char* data, qint64 size) { return bgzf.write(data, size); });
+    bool ok = tar.addDirectory("data");
+    for (int i = 0; ok && i < kFileCount; ++i) {
+        ok = tar.addFile(fileName(i), fileContent(i));
+    }
+    QVERIFY(ok && tar.finish() && bgzf.finish());
+}
+
+void ExtractionResumeTest::resumeFromCheckpoint_data() {
+    // Точки перезапуска: концы порций ParallelInflater или начала отдельных блоков BGZF
+    QTest::addColumn<int>("decoderThreads");
+    QTest::newRow("parallel") << 4;
+    QTest::newRow("sequential") << 1;
+}
+
+void ExtractionResumeTest::resumeFromCheckpoint() {
+    QFETCH(int, decoderThreads);
+    const QString name = QString("resume-%1").arg(decoderThreads);
+    const QString target = QDir(m_temp.path()).filePath(name);
+    ExtractionJournal journal(QDir(m_temp.path()).filePath(name + ".journal"));
+
+    {
+        ArchiveExtractor extractor(target);
+        extractor.setThreadCounts(decoderThreads, 2);
+        extractor.setJournal(&journal);
+        QVERIFY2(extractor.extract(m_archivePath), qPrintable(extractor.errorString()));
+        QVERIFY(!extractor.isResumed());
+    }
+    ExtractionCheckpoint checkpoint;
+    QVERIFY(journal.load(&checkpoint));
+    QVERIFY(checkpoint.isValid());
+    QVERIFY(checkpoint.entries > 0 && checkpoint.entries < kFileCount + 1);
+    // Заголовки не совпадают с границами блоков: декодирование продолжается посреди данных записи
+    QVERIFY(checkpoint.restartOutput < checkpoint.resumeOutput);
+
+    // Состояние после сбоя: файлы до точки на диске, последнего файла ещё нет.
+    // Первый файл помечен - при продолжении он не должен переписываться
+    const QString first = QDir(target).filePath(fileName(0));
+    const QString last = QDir(target).filePath(fileName(kFileCount - 1));
+    {
+        QFile file(first);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write("marker");
+    }
+    QVERIFY(QFile::remove(last));
+
+    ArchiveExtractor extractor(target);
+    extractor.setThreadCounts(decoderThreads, 2);
+    extractor.setJournal(&journal, checkpoint);
+    QVERIFY2(extractor.extract(m_archivePath), qPrintable(extractor.errorString()));
+    QVERIFY(extractor.isResumed());
+    QCOMPARE(extractor.entriesWritten(), qint64(kFileCount + 1));
+    QCOMPARE(readFile(first), QByteArray("marker"));
+    QCOMPARE(readFile(last), fileContent(kFileCount - 1));
+}
+
+void ExtractionResumeTest::checkpointOfOtherArchiveIsIgnored() {
+    const QString target = QDir(m_temp.path()).filePath("restart");
+    ExtractionJournal journal(QDir(m_temp.path()).filePath("restart.journal"));
+    {
+        ArchiveExtractor extractor(target);
+        extractor.setJournal(&journal);
+        QVERIFY2(extractor.extract(m_archivePath), qPrintable(extractor.errorString()));
+    }
+    ExtractionCheckpoint checkpoint;
+    QVERIFY(journal.load(&checkpoint));
+    // Пересобранный архив того же пути и размера
+    checkpoint.archiveFingerprint = QByteArray(32, 'x');
+
+    const QString first = QDir(target).filePath(fileName(0));
+    QVERIFY(QFile::remove(first));
+    ArchiveExtractor extractor(target);
+    extractor.setJournal(&journal, checkpoint);
+    QVERIFY2(extractor.extract(m_archivePath), qPrintable(extractor.errorString()));
+    QVERIFY(!extractor.isResumed());
+    QCOMPARE(readFile(first), fileContent(0));
+}
+
+void ExtractionResumeTest::fingerprintDistinguishesSameSizeArchives() {
+    const QString path = QDir(m_temp.path()).filePath("same-size.bin");
+    auto writeArchive = [&path](char fill) {
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(QByteArray(4096, fill)) == 4096;
+    };
+    QVERIFY(writeArchive('a'));
+    const QByteArray first = ExtractionJournal::fingerprint(path, QByteArray());
+    QVERIFY(!first.isEmpty());
+    QCOMPARE(ExtractionJournal::fingerprint(path, QByteArray()), first);
+    QVERIFY(writeArchive('b'));
+    QVERIFY(ExtractionJournal::fingerprint(path, QByteArray()) != first);
+}
+
+QTEST_GUILESS_MAIN(ExtractionResumeTest)
+
+#include "ExtractionResumeTest.moc"
\ No newline at end of file